@@ -0,0 +1,820 @@
+#include "collapsible.h"
+#include "outofcore.h"
+#include "parallel.h"
+#include "progressive.h"
+#include "qefbatch.h"
+
+#include <algorithm>  // clamp, max, min
+#include <array>      // array, tuple_size_v
+#include <chrono>     // steady_clock, duration
+#include <cmath>      // cbrt, sqrt
+#include <cstring>    // memcmp, strcmp
+#include <filesystem> // file_size, path, remove, temp_directory_path
+#include <functional> // function
+#include <iostream>   // cout, cerr, endl
+#include <queue>      // priority_queue, greater
+#include <string>     // string, stoul, stoull, to_string
+#include <sys/resource.h> // getrusage
+#include <unistd.h>   // getpid
+#include <utility>    // pair
+
+using namespace std;
+
+
+// Best of several runs, in seconds
+template <class Op>
+static double timeBest(unsigned repeats, Op op) {
+    double best = numeric_limits<double>::max();
+    for (unsigned i = 0u; i < repeats; ++i) {
+        const auto start = chrono::steady_clock::now();
+        op();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+
+//////////
+// LOAD //
+//////////
+static void benchLoad(const char* file, unsigned repeats) {
+    const double megabytes = static_cast<double>(filesystem::file_size(file)) / (1024.0 * 1024.0);
+
+    struct { const char *name; LoadMode mode; } modes[] = {
+        { "stream", LoadMode::Stream },
+        { "mapped", LoadMode::Mapped },
+        { "parallel", LoadMode::Parallel },
+    };
+
+    cout << file << ": " << megabytes << "MB" << endl;
+    for (const auto &[name, mode] : modes) {
+        size_t faces = 0ul;
+        const double parse = timeBest(repeats, [&]{ faces = readMesh(file, mode).faceCount(); });
+        const double load = timeBest(repeats, [&]{ Manifold<> m(file, mode); });
+
+        cout << "  " << name << ": " << faces << " faces, parse " << parse * 1000.0 << "ms ("
+             << megabytes / parse << "MB/s), full load " << load * 1000.0 << "ms" << endl;
+    }
+
+    // Vertex QEFs only live on Collapsible, so compare at that level
+    { Collapsible warm(file); }
+    const double parsed = timeBest(repeats, [&]{ Collapsible c(file, LoadMode::Parallel, false); });
+    const double cached = timeBest(repeats, [&]{ Collapsible c(file); });
+    cout << "  collapsible: parsed " << parsed * 1000.0 << "ms, cached " << cached * 1000.0 << "ms" << endl;
+}
+
+
+/////////
+// QEF //
+/////////
+// The one-ring walk as it was before circulators, kept here as the baseline
+static void traverseEdges(const Manifold<>& mesh, uint32_t v, function<void(uint32_t)> op) {
+    const uint32_t start = mesh.vertex(v).he;
+    uint32_t it = start;
+    do op(it);
+    while ((it = mesh.nextAround(it)) != start);
+}
+
+static DistanceQEF baselineQEF(const Manifold<>& mesh, uint32_t v) {
+    float n = 0.0f, Svtv = 0.0f;
+    f32v3 Sv = {};
+    traverseEdges(mesh, v, [&](uint32_t it) {
+        ++n;
+        Sv += mesh.vertex(mesh.head(it)).pos;
+        Svtv += mesh.vertex(mesh.head(it)).pos.dot(mesh.vertex(mesh.head(it)).pos);
+    });
+    return { n, Sv, Svtv };
+}
+
+// Builds a QEF for every vertex of a plain mesh, folding each into a sum so none is optimized away
+struct QEFSweep : Manifold<> {
+    using Manifold::Manifold;
+
+    template <class Init>
+    float sweep(Init init) const {
+        float sink = 0.0f;
+        for (uint32_t v = 0u; v < m_vertices.size(); ++v)
+            if (!m_vertices[v].invalid())
+                sink += init(*this, v).evaluateError(m_vertices[v].pos);
+        return sink;
+    }
+
+    size_t vertexCount() const { return m_vertices.size(); }
+};
+
+static void benchQEF(const char* file, unsigned repeats) {
+    const QEFSweep mesh(file);
+
+    volatile float sink;
+    const double function = timeBest(repeats, [&]{ sink = mesh.sweep(baselineQEF); });
+    const double circulator = timeBest(repeats, [&]{ sink = mesh.sweep([](const Manifold<>& m, uint32_t v){ return DistanceQEF(m, v); }); });
+    const double plane = timeBest(repeats, [&]{ sink = mesh.sweep([](const Manifold<>& m, uint32_t v){ return PlaneQEF(m, v); }); });
+    const double perVertex = 1e9 / static_cast<double>(mesh.vertexCount());
+
+    cout << file << ": " << mesh.vertexCount() << " vertex QEFs" << endl
+         << "  std::function: " << function * 1000.0 << "ms (" << function * perVertex << "ns/vertex)" << endl
+         << "  circulator: " << circulator * 1000.0 << "ms (" << circulator * perVertex << "ns/vertex), "
+         << function / circulator << "x" << endl
+         << "  plane: " << plane * 1000.0 << "ms (" << plane * perVertex << "ns/vertex)" << endl;
+}
+
+
+//////////
+// HEAP //
+//////////
+// Simplification as it was with a lazy priority queue, kept here as the baseline
+struct LazyCollapsible : Collapsible {
+    using Collapsible::Collapsible;
+
+    QueueStats lazySimplify(uint64_t finalCount) {
+        struct EdgeRef {
+            QEFEdge<DistanceQEF> *e;
+            float error;
+
+            EdgeRef(QEFEdge<DistanceQEF> *e): e(e), error(e->error()) {}
+
+            auto operator<=>(const EdgeRef& o) const { return error <=> o.error; }
+        };
+
+        QueueStats stats;
+        vector<bool> dirty(m_edges.size(), false);
+        priority_queue<EdgeRef, vector<EdgeRef>, greater<EdgeRef>> errors;
+        auto push = [&](QEFEdge<DistanceQEF>* e) {
+            errors.push({ e });
+            ++stats.pushes;
+            stats.peakSize = max(stats.peakSize, errors.size());
+        };
+
+        for (QEFEdge<DistanceQEF> &e : m_edges)
+            if (!e.invalid() && !locked(e))
+                push(&e);
+
+        while (faceCount() > finalCount && !errors.empty()) {
+            QEFEdge<DistanceQEF> *top = errors.top().e;
+            errors.pop();
+            ++stats.pops;
+
+            if (top->invalid()) {
+                // Deleted by an earlier collapse, a wasted pop
+            } else if (dirty[handle(top)]) {
+                updateQEF(*top);
+                dirty[handle(top)] = false;
+                push(top);
+            } else if (!checkSafety(*top)) {
+                top->unsafe = true;
+            } else {
+                const uint32_t remainingVertex = m_halfedges[top->he].v;
+                m_removedFaces += collapse(*top);
+
+                for (uint32_t he : outgoing(remainingVertex)) {
+                    QEFEdge<DistanceQEF> *edge = &m_edges[m_halfedges[he].e];
+                    dirty[handle(edge)] = true;
+                    if (edge->unsafe) {
+                        edge->unsafe = false;
+                        push(edge);
+                    }
+                }
+            }
+        }
+        return stats;
+    }
+};
+
+static void benchHeap(const char* file, uint64_t target) {
+    auto report = [](const char* name, const QueueStats& stats, double seconds, size_t faces) {
+        cout << "  " << name << ": " << faces << " faces in " << seconds * 1000.0 << "ms, " << stats.pops << " pops, "
+             << stats.pushes << " pushes, " << stats.updates << " updates, " << stats.removals << " removals, peak heap "
+             << stats.peakSize << endl;
+    };
+
+    cout << file << " down to " << target << " faces" << endl;
+    {
+        LazyCollapsible lazy(file, LoadMode::Parallel, false);
+        QueueStats stats;
+        const double seconds = timeBest(1u, [&]{ stats = lazy.lazySimplify(target); });
+        report("lazy", stats, seconds, lazy.faceCount());
+    }
+    {
+        Collapsible indexed(file, LoadMode::Parallel, false);
+        QueueStats stats;
+        const double seconds = timeBest(1u, [&]{ stats = indexed.simplify(target).queue; });
+        report("indexed", stats, seconds, indexed.faceCount());
+    }
+}
+
+
+///////////
+// BATCH //
+///////////
+static void benchBatch(const char* file, uint64_t target, unsigned threads) {
+    cout << file << " down to " << target << " faces, threads: " << threads << endl;
+    for (size_t batchSize : { 1ul, 64ul, 256ul, 1024ul, 4096ul }) {
+        Collapsible mesh(file, LoadMode::Parallel, false);
+        QueueStats stats;
+        const double seconds = timeBest(1u, [&]{ stats = mesh.simplify(target, { .batchSize = batchSize, .threads = threads }).queue; });
+        cout << "  batch " << batchSize << ": " << mesh.faceCount() << " faces in " << seconds * 1000.0 << "ms, "
+             << stats.pops << " pops" << endl;
+    }
+}
+
+
+/////////////
+// ENGINES //
+/////////////
+// Total quadric error of the merged vertices, how far the result strays from the surfaces it replaced
+struct ErrorProbe : Collapsible {
+    using Collapsible::Collapsible;
+
+    double totalError() const {
+        double total = 0.0;
+        for (const QEFVertex<DistanceQEF> &v : m_vertices)
+            if (!v.invalid())
+                total += v.qef.evaluateError(v.pos);
+        return total;
+    }
+};
+
+static void benchEngines(const char* file, uint64_t target) {
+    struct { const char *name; SimplifyOptions options; size_t entryBytes; } engines[] = {
+        { "heap", {}, sizeof(pair<float, QEFEdge<DistanceQEF>*>) },
+        { "batch 256", { .batchSize = 256ul }, sizeof(pair<float, QEFEdge<DistanceQEF>*>) },
+        { "tiled", { .engine = SimplifyEngine::Tiled }, sizeof(pair<float, QEFEdge<DistanceQEF>*>) },
+        { "choice 2", { .engine = SimplifyEngine::MultipleChoice, .samples = 2u }, sizeof(QEFEdge<DistanceQEF>*) },
+        { "choice 4", { .engine = SimplifyEngine::MultipleChoice, .samples = 4u }, sizeof(QEFEdge<DistanceQEF>*) },
+        { "choice 8", { .engine = SimplifyEngine::MultipleChoice, .samples = 8u }, sizeof(QEFEdge<DistanceQEF>*) },
+        { "choice 16", { .engine = SimplifyEngine::MultipleChoice, .samples = 16u }, sizeof(QEFEdge<DistanceQEF>*) },
+    };
+
+    cout << file << " down to " << target << " faces" << endl;
+    for (const auto &[name, options, entryBytes] : engines) {
+        ErrorProbe mesh(file, LoadMode::Parallel, false);
+        QueueStats stats;
+        const double seconds = timeBest(1u, [&]{ stats = mesh.simplify(target, options).queue; });
+        cout << "  " << name << ": " << mesh.faceCount() << " faces in " << seconds * 1000.0 << "ms, queue peak "
+             << stats.peakSize * entryBytes / 1024ul << "KiB, total error " << mesh.totalError() << endl;
+    }
+}
+
+
+/////////
+// LOD //
+/////////
+static void benchLOD(const char* file) {
+    const uint64_t faces = Collapsible(file).faceCount();
+    vector<uint64_t> targets;
+    for (double fraction : { 0.5, 0.1, 0.02, 0.005, 0.001 })
+        targets.push_back(static_cast<uint64_t>(static_cast<double>(faces) * fraction));
+
+    vector<MeshData> chain;
+    const double chained = timeBest(1u, [&]{ chain = Collapsible(file).simplify(targets); });
+    const double deepest = timeBest(1u, [&]{ Collapsible(file).simplify(targets.back()); });
+
+    cout << file << ": " << faces << " faces" << endl;
+    double separate = 0.0;
+    for (size_t i = 0ul; i < targets.size(); ++i) {
+        size_t alone = 0ul;
+        separate += timeBest(1u, [&]{ Collapsible mesh(file); mesh.simplify(targets[i]); alone = mesh.faceCount(); });
+        cout << "  target " << targets[i] << ": chain " << chain[i].faceCount() << " faces, alone " << alone << " faces" << endl;
+    }
+    cout << "  chain " << chained * 1000.0 << "ms, deepest alone " << deepest * 1000.0 << "ms, every target alone "
+         << separate * 1000.0 << "ms" << endl;
+}
+
+
+///////////
+// TILES //
+///////////
+static void benchTiles(const char* file, uint64_t target) {
+    cout << file << " down to " << target << " faces" << endl;
+    {
+        ErrorProbe mesh(file, LoadMode::Parallel, false);
+        const double seconds = timeBest(1u, [&]{ mesh.simplify(target); });
+        cout << "  heap: " << mesh.faceCount() << " faces in " << seconds * 1000.0 << "ms, total error " << mesh.totalError() << endl;
+    }
+    for (unsigned tiles : { 1u, 2u, 4u, 8u, 16u }) {
+        ErrorProbe mesh(file, LoadMode::Parallel, false);
+        const double seconds = timeBest(1u, [&]{ mesh.simplify(target, { .engine = SimplifyEngine::Tiled, .threads = tiles }); });
+        cout << "  tiles " << tiles << ": " << mesh.faceCount() << " faces in " << seconds * 1000.0 << "ms, total error "
+             << mesh.totalError() << endl;
+    }
+}
+
+
+/////////////
+// CLUSTER //
+/////////////
+static void benchCluster(const char* file, uint64_t target) {
+    cout << file << " down to " << target << " faces" << endl;
+    for (float ratio : { 0.0f, 2.0f, 4.0f, 8.0f, 16.0f, 64.0f }) {
+        ErrorProbe mesh(file, LoadMode::Parallel, false);
+        const double seconds = timeBest(1u, [&]{ mesh.simplify(target, { .clusterRatio = ratio }); });
+        cout << "  cluster " << ratio << "x: " << mesh.faceCount() << " faces in " << seconds * 1000.0 << "ms, total error "
+             << mesh.totalError() << endl;
+    }
+}
+
+
+/////////////
+// METRICS //
+/////////////
+// Barycentric weights of the nearest point of triangle abc to p, after Ericson's Real-Time Collision Detection 5.1.5
+static f32v3 closestOnTriangle(const f32v3& p, const f32v3& a, const f32v3& b, const f32v3& c) {
+    const f32v3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return { 1.0f, 0.0f, 0.0f };
+
+    const f32v3 bp = p - b;
+    const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return { 0.0f, 1.0f, 0.0f };
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        const float t = d1 / (d1 - d3);
+        return { 1.0f - t, t, 0.0f };
+    }
+
+    const f32v3 cp = p - c;
+    const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return { 0.0f, 0.0f, 1.0f };
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        const float t = d2 / (d2 - d6);
+        return { 1.0f - t, 0.0f, t };
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        const float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return { 0.0f, 1.0f - t, t };
+    }
+
+    const float denominator = 1.0f / (va + vb + vc), v = vb * denominator, w = vc * denominator;
+    return { 1.0f - v - w, v, w };
+}
+
+// Nearest distance to a mesh's surface, its faces fanned into triangles and bucketed in a uniform grid. Unlike the
+// quadric totals this measures both metrics with the same ruler.
+class SurfaceDistance {
+public:
+    explicit SurfaceDistance(const MeshData& mesh) : m_positions(mesh.positions) {
+        m_lo = m_hi = mesh.positions.front();
+        for (const f32v3 &p : mesh.positions) {
+            m_lo = { min(m_lo.x, p.x), min(m_lo.y, p.y), min(m_lo.z, p.z) };
+            m_hi = { max(m_hi.x, p.x), max(m_hi.y, p.y), max(m_hi.z, p.z) };
+        }
+
+        for (size_t face = 0ul; face < mesh.faceCount(); ++face)
+            for (uint32_t corner = mesh.faceStarts[face] + 1u; corner + 1u < mesh.faceStarts[face + 1ul]; ++corner)
+                m_triangles.push_back({ mesh.indices[mesh.faceStarts[face]], mesh.indices[corner], mesh.indices[corner + 1u] });
+
+        // About one triangle per cell
+        m_resolution = max(1, static_cast<int>(cbrt(static_cast<double>(m_triangles.size()))));
+        m_cell = max((m_hi - m_lo).max() / static_cast<float>(m_resolution), numeric_limits<float>::min());
+        m_cells.resize(static_cast<size_t>(m_resolution) * m_resolution * m_resolution);
+
+        for (uint32_t t = 0u; t < m_triangles.size(); ++t) {
+            const auto &[a, b, c] = m_triangles[t];
+            const array<int, 3> lo = cellOf({ min({ m_positions[a].x, m_positions[b].x, m_positions[c].x }),
+                                              min({ m_positions[a].y, m_positions[b].y, m_positions[c].y }),
+                                              min({ m_positions[a].z, m_positions[b].z, m_positions[c].z }) });
+            const array<int, 3> hi = cellOf({ max({ m_positions[a].x, m_positions[b].x, m_positions[c].x }),
+                                              max({ m_positions[a].y, m_positions[b].y, m_positions[c].y }),
+                                              max({ m_positions[a].z, m_positions[b].z, m_positions[c].z }) });
+            for (int x = lo[0]; x <= hi[0]; ++x)
+                for (int y = lo[1]; y <= hi[1]; ++y)
+                    for (int z = lo[2]; z <= hi[2]; ++z)
+                        m_cells[index(x, y, z)].push_back(t);
+        }
+    }
+
+    // The nearest point of the surface, as the triangle it lies on and its weights for that triangle's corners
+    struct Nearest {
+        float distanceSqr = numeric_limits<float>::max();
+        array<uint32_t, 3> corners = {};
+        f32v3 weights;
+    };
+
+    Nearest nearest(const f32v3& p) const {
+        // Search shells of cells outwards until no farther shell can hold anything closer
+        const array<int, 3> home = cellOf(p);
+        Nearest best;
+        for (int ring = 0; ring <= m_resolution; ++ring) {
+            for (int x = home[0] - ring; x <= home[0] + ring; ++x)
+                for (int y = home[1] - ring; y <= home[1] + ring; ++y)
+                    for (int z = home[2] - ring; z <= home[2] + ring; ++z) {
+                        const bool shell = abs(x - home[0]) == ring || abs(y - home[1]) == ring || abs(z - home[2]) == ring;
+                        if (!shell || min({ x, y, z }) < 0 || max({ x, y, z }) >= m_resolution)
+                            continue;
+                        for (uint32_t t : m_cells[index(x, y, z)]) {
+                            const auto &[a, b, c] = m_triangles[t];
+                            const f32v3 weights = closestOnTriangle(p, m_positions[a], m_positions[b], m_positions[c]);
+                            const float d = (m_positions[a] * weights.x + m_positions[b] * weights.y + m_positions[c] * weights.z - p).lengthSqr();
+                            if (d < best.distanceSqr)
+                                best = { d, m_triangles[t], weights };
+                        }
+                    }
+
+            const float reach = static_cast<float>(ring) * m_cell;
+            if (best.distanceSqr <= reach * reach)
+                break;
+        }
+        return best;
+    }
+
+    float distanceSqr(const f32v3& p) const { return nearest(p).distanceSqr; }
+
+    // A per vertex channel of the mesh blended at a nearest point
+    template <class T>
+    static T interpolate(const Nearest& at, const vector<T>& values) {
+        return values[at.corners[0]] * at.weights.x + values[at.corners[1]] * at.weights.y + values[at.corners[2]] * at.weights.z;
+    }
+
+    float diagonal() const { return (m_hi - m_lo).length(); }
+
+private:
+    array<int, 3> cellOf(const f32v3& p) const {
+        auto axis = [&](float c, float lo) { return clamp(static_cast<int>((c - lo) / m_cell), 0, m_resolution - 1); };
+        return { axis(p.x, m_lo.x), axis(p.y, m_lo.y), axis(p.z, m_lo.z) };
+    }
+
+    size_t index(int x, int y, int z) const { return (static_cast<size_t>(x) * m_resolution + y) * m_resolution + z; }
+
+    const vector<f32v3> &m_positions;
+    vector<array<uint32_t, 3>> m_triangles;
+    vector<vector<uint32_t>> m_cells;
+    f32v3 m_lo, m_hi;
+    float m_cell;
+    int m_resolution;
+};
+
+// How far the original vertices ended up from the simplified surface as a fraction of its size, rms and worst
+static pair<double, double> distanceTo(const MeshData& original, const MeshData& simplified) {
+    const SurfaceDistance surface(simplified);
+    double sum = 0.0, worst = 0.0;
+    for (const f32v3 &p : original.positions) {
+        const double d = surface.distanceSqr(p);
+        sum += d;
+        worst = max(worst, d);
+    }
+    const double scale = 1.0 / surface.diagonal();
+    return { sqrt(sum / static_cast<double>(original.positions.size())) * scale, sqrt(worst) * scale };
+}
+
+static void benchMetrics(const char* file, uint64_t target) {
+    const MeshData original = readMesh(file);
+
+    struct { const char *name; ErrorMetric metric; } metrics[] = {
+        { "distance", ErrorMetric::Distance },
+        { "plane", ErrorMetric::Plane },
+    };
+
+    cout << file << " down to " << target << " faces" << endl;
+    for (const auto &[name, metric] : metrics) {
+        MeshData simplified;
+        double simplifySeconds = 0.0;
+        const double total = timeBest(1u, [&]{
+            withMetric(metric, [&](auto& mesh) {
+                simplifySeconds = timeBest(1u, [&]{ mesh.simplify(target); });
+                simplified = mesh.exportMesh();
+            }, original);
+        });
+
+        const auto [rms, worst] = distanceTo(original, simplified);
+        cout << "  " << name << ": " << simplified.faceCount() << " faces, build " << (total - simplifySeconds) * 1000.0
+             << "ms, simplify " << simplifySeconds * 1000.0 << "ms, rms distance " << rms << ", max " << worst << endl;
+    }
+}
+
+
+////////////////
+// ATTRIBUTES //
+////////////////
+// The channel an attribute metric carries, and a value of it fit to compare: blended normals come out short
+template <class QEF, class Mesh>
+static auto& channelOf(Mesh& mesh) {
+    if constexpr (tuple_size_v<typename QEF::Attributes> == 3ul)
+        return mesh.normals;
+    else
+        return mesh.uvs;
+}
+
+static f32v3 settle(const f32v3& normal) { return normal.lengthSqr() > 0.0f ? normal.normalize() : normal; }
+static f32v2 settle(const f32v2& uv) { return uv; }
+
+// Position only with the attributes looked up on the original surface afterwards, against carrying them through
+// every collapse. Both are then held to the original: how far its vertices are from the result, and how far their
+// attributes are from the result's there.
+template <class QEF>
+static void benchAttributes(const char* name, const MeshData& original, uint64_t target) {
+    const auto &values = channelOf<QEF>(original);
+    if (values.size() != original.positions.size()) {
+        cout << "  no " << name << endl;
+        return;
+    }
+
+    auto report = [&](const char* label, const MeshData& simplified, double build, double simplify, double reproject) {
+        const SurfaceDistance surface(simplified);
+        const auto &simplifiedValues = channelOf<QEF>(simplified);
+
+        vector<double> distances(original.positions.size()), differences(original.positions.size());
+        parallelFor(original.positions.size(), [&](size_t i) {
+            const auto nearest = surface.nearest(original.positions[i]);
+            const auto difference = settle(SurfaceDistance::interpolate(nearest, simplifiedValues)) - values[i];
+            distances[i] = nearest.distanceSqr;
+            differences[i] = difference.dot(difference);
+        });
+
+        double distance = 0.0, difference = 0.0;
+        for (size_t i = 0ul; i < distances.size(); ++i) {
+            distance += distances[i];
+            difference += differences[i];
+        }
+        const double count = static_cast<double>(distances.size());
+
+        cout << "  " << label << ": " << simplified.faceCount() << " faces, build " << build * 1000.0 << "ms, simplify "
+             << simplify * 1000.0 << "ms";
+        if (reproject > 0.0)
+            cout << ", reproject " << reproject * 1000.0 << "ms";
+        cout << ", rms distance " << sqrt(distance / count) / surface.diagonal() << ", rms " << name << " error "
+             << sqrt(difference / count) << endl;
+    };
+
+    auto run = [&]<class Metric>(MeshData& simplified, double& build, double& simplify) {
+        const double total = timeBest(1u, [&]{
+            BasicCollapsible<Metric> mesh(original);
+            simplify = timeBest(1u, [&]{ mesh.simplify(target); });
+            simplified = mesh.exportMesh();
+        });
+        build = total - simplify;
+    };
+
+    MeshData plain, carried;
+    double plainBuild, plainSimplify, carriedBuild, carriedSimplify;
+    run.template operator()<PlaneQEF>(plain, plainBuild, plainSimplify);
+    run.template operator()<QEF>(carried, carriedBuild, carriedSimplify);
+
+    const double reproject = timeBest(1u, [&]{
+        const SurfaceDistance surface(original);
+        auto &lookedUp = channelOf<QEF>(plain);
+        lookedUp.resize(plain.positions.size());
+        parallelFor(plain.positions.size(), [&](size_t i) {
+            lookedUp[i] = settle(SurfaceDistance::interpolate(surface.nearest(plain.positions[i]), values));
+        });
+    });
+
+    report("plane, reprojected", plain, plainBuild, plainSimplify, reproject);
+    report("plane, carried", carried, carriedBuild, carriedSimplify, 0.0);
+}
+
+
+//////////
+// SIMD //
+//////////
+// The edge QEFs of a freshly built mesh, packed for the batched kernels
+template <class QEF>
+struct EdgeBatches : BasicCollapsible<QEF> {
+    using BasicCollapsible<QEF>::BasicCollapsible;
+
+    vector<QEFBatch<QEF>> pack(size_t limit) const {
+        vector<QEFBatch<QEF>> batches;
+        for (const QEFEdge<QEF> &e : this->m_edges) {
+            if (limit-- == 0ul)
+                break;
+            if (batches.empty() || batches.back().full())
+                batches.emplace_back();
+            batches.back().push(e.qef);
+        }
+        return batches;
+    }
+
+    float diagonal() const { return this->getAABBSizes().length(); }
+};
+
+template <class QEF>
+static void benchSIMD(const char* name, const char* file) {
+    const EdgeBatches<QEF> mesh(file, LoadMode::Parallel, false);
+    vector<QEFBatch<QEF>> batches = mesh.pack(1ul << 18u), reference;
+    const double perEdge = 1e9 / static_cast<double>(min<size_t>(1ul << 18u, (batches.size() - 1ul) * BatchPoints::capacity + batches.back().count));
+
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if (level > simdLevel())
+            break;
+
+        const double minimize = timeBest(3u, [&]{ for (auto &batch : batches) minimizeBatch(batch, level); });
+        const double evaluate = timeBest(3u, [&]{ for (auto &batch : batches) evaluateBatch(batch, level); });
+        cout << "  " << name << " " << simdLevelName(level) << ": minimize " << minimize * perEdge << "ns/edge, evaluate "
+             << evaluate * perEdge << "ns/edge";
+
+        if (level == SimdLevel::Scalar) {
+            reference = batches;
+            cout << endl;
+            continue;
+        }
+
+        // How far the wide kernels stray from the scalar answers, relative to the mesh and to the typical error. Many
+        // errors are down in the rounding noise, so comparing each to itself would say nothing.
+        double moved = 0.0, drift = 0.0, typical = 0.0, count = 0.0;
+        for (size_t b = 0ul; b < batches.size(); ++b) {
+            for (size_t i = 0ul; i < batches[b].count; ++i, ++count) {
+                moved = max<double>(moved, (batches[b].point(i) - reference[b].point(i)).length());
+                drift = max<double>(drift, abs(batches[b].error[i] - reference[b].error[i]));
+                typical += abs(reference[b].error[i]);
+            }
+        }
+        cout << ", moved at most " << moved / mesh.diagonal() << ", error drift at most " << drift * count / typical
+             << " of the mean" << endl;
+    }
+}
+
+
+// Every face of a freshly built mesh, packed for the plane kernel, and each plane as FacePlane works it out
+struct FaceBatches : Manifold<> {
+    using Manifold::Manifold;
+
+    vector<PlaneBatch> pack() const {
+        vector<PlaneBatch> batches;
+        for (const Face &f : m_faces) {
+            if (batches.empty() || batches.back().full())
+                batches.emplace_back();
+            const Halfedge &a = m_halfedges[f.he], &b = m_halfedges[a.next], &c = m_halfedges[b.next];
+            batches.back().push(m_vertices[a.v].pos, m_vertices[b.v].pos, m_vertices[c.v].pos, m_vertices[m_halfedges[c.next].v].pos);
+        }
+        return batches;
+    }
+
+    vector<FacePlane> planes() const {
+        vector<FacePlane> planes;
+        for (uint32_t f = 0u; f < m_faces.size(); ++f)
+            planes.emplace_back(*this, f);
+        return planes;
+    }
+};
+
+static void benchPlanes(const char* file) {
+    const FaceBatches mesh(file, LoadMode::Parallel);
+    vector<PlaneBatch> batches = mesh.pack();
+    const vector<FacePlane> reference = mesh.planes();
+    const double perFace = 1e9 / static_cast<double>(reference.size());
+
+    const double gathered = timeBest(3u, [&]{ batches = mesh.pack(); });
+    cout << "  planes: gather " << gathered * perFace << "ns/face" << endl;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+        if (level > simdLevel())
+            break;
+
+        const double seconds = timeBest(3u, [&]{ for (auto &batch : batches) planeBatch(batch, level); });
+
+        // Degenerate faces have no plane to agree on, both sides leave them short of unit length or not a number
+        double turned = 0.0, shifted = 0.0;
+        for (size_t f = 0ul; f < reference.size(); ++f) {
+            const FacePlane plane = batches[f / PlaneBatch::capacity][f % PlaneBatch::capacity];
+            if (reference[f].n.lengthSqr() > 0.5f) {
+                turned = max<double>(turned, (plane.n - reference[f].n).length());
+                shifted = max<double>(shifted, abs(plane.d - reference[f].d));
+            }
+        }
+        cout << "  planes " << simdLevelName(level) << ": " << seconds * perFace << "ns/face, normals off by at most "
+             << turned << ", offsets by " << shifted << endl;
+    }
+}
+
+
+/////////////////
+// PROGRESSIVE //
+/////////////////
+static void benchProgressive(const char* file, uint64_t target) {
+    const filesystem::path stream = filesystem::temp_directory_path() / ("simplify-bench-" + to_string(getpid()) + ".prog");
+
+    Collapsible mesh(file, LoadMode::Parallel, false);
+    const uint64_t faces = mesh.faceCount();
+    mesh.simplify(target, { .record = true });
+    const MeshData coarse = mesh.exportMesh();
+
+    const double write = timeBest(1u, [&]{ mesh.writeProgressive(stream.c_str()); });
+    const double megabytes = static_cast<double>(filesystem::file_size(stream)) / (1024.0 * 1024.0);
+    MeshData base, full;
+    const double readBase = timeBest(3u, [&]{ base = readProgressive(stream.c_str(), 0ul); });
+    const double readFull = timeBest(3u, [&]{ full = readProgressive(stream.c_str()); });
+    filesystem::remove(stream);
+
+    // The base is exported the same way as the coarse level, so it has to match it exactly
+    const bool baseMatches = base.positions.size() == coarse.positions.size() && base.indices == coarse.indices
+        && base.faceStarts == coarse.faceStarts
+        && !memcmp(base.positions.data(), coarse.positions.data(), base.positions.size() * sizeof(f32v3));
+
+    cout << file << ": " << faces << " faces down to " << coarse.faceCount() << ", " << mesh.recordedCollapses()
+         << " splits in " << megabytes << "MB" << endl
+         << "  write " << write * 1000.0 << "ms, read base " << readBase * 1000.0 << "ms, read all " << readFull * 1000.0
+         << "ms (" << megabytes / readFull << "MB/s)" << endl
+         << "  base " << (baseMatches ? "matches" : "DIFFERS FROM") << " the coarse level, refined back to "
+         << full.faceCount() << " of " << faces << " faces" << endl;
+}
+
+
+///////////////
+// OUTOFCORE //
+///////////////
+// The most this process has held so far, in megabytes. It never goes down, so the lean path runs first.
+static double peakMegabytes() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+}
+
+static void benchOutOfCore(const char* file, uint64_t target, size_t memoryBudget) {
+    const filesystem::path output = filesystem::temp_directory_path() / ("simplify-bench-" + to_string(getpid()) + ".obj");
+    cout << file << " down to " << target << " faces, " << static_cast<double>(memoryBudget) / (1024.0 * 1024.0) << "MB budget" << endl;
+
+    OutOfCoreStats stats;
+    const double outOfCore = timeBest(1u, [&]{ stats = simplifyOutOfCore(file, output.c_str(), target, memoryBudget); });
+    const double outOfCorePeak = peakMegabytes();
+    const MeshData streamed = readMesh(output.c_str());
+    filesystem::remove(output);
+
+    MeshData inCore;
+    const double whole = timeBest(1u, [&]{
+        Collapsible mesh(file, LoadMode::Parallel, false);
+        mesh.simplify(target);
+        inCore = mesh.exportMesh();
+    });
+    const double inCorePeak = peakMegabytes();
+
+    const MeshData original = readMesh(file);
+    const auto [inCoreRms, inCoreWorst] = distanceTo(original, inCore);
+    const auto [streamedRms, streamedWorst] = distanceTo(original, streamed);
+    cout << "  in core: " << inCore.faceCount() << " faces in " << whole * 1000.0 << "ms, peak " << inCorePeak
+         << "MB, rms distance " << inCoreRms << ", max " << inCoreWorst << endl
+         << "  out of core: " << streamed.faceCount() << " faces in " << outOfCore * 1000.0 << "ms after " << stats.rounds
+         << " rounds of slabs, peak " << outOfCorePeak << "MB, rms distance " << streamedRms << ", max " << streamedWorst << endl;
+}
+
+
+//////////
+// MAIN //
+//////////
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " load|qef <file> [repeats]" << endl
+             << "       " << argv[0] << " heap <file> <faces>" << endl
+             << "       " << argv[0] << " batch <file> <faces> [threads]" << endl
+             << "       " << argv[0] << " engines <file> <faces>" << endl
+             << "       " << argv[0] << " lod <file>" << endl
+             << "       " << argv[0] << " tiles <file> <faces>" << endl
+             << "       " << argv[0] << " cluster <file> <faces>" << endl
+             << "       " << argv[0] << " metrics <file> <faces>" << endl
+             << "       " << argv[0] << " attributes <file> <faces>" << endl
+             << "       " << argv[0] << " simd <file>" << endl
+             << "       " << argv[0] << " progressive <file> <faces>" << endl
+             << "       " << argv[0] << " outofcore <file> <faces> <budget bytes>" << endl;
+        return 1;
+    }
+
+    try {
+        const unsigned repeats = argc > 3 ? stoul(argv[3]) : 3u;
+        if (!strcmp(argv[1], "load")) {
+            benchLoad(argv[2], repeats);
+        } else if (!strcmp(argv[1], "qef")) {
+            benchQEF(argv[2], repeats);
+        } else if (!strcmp(argv[1], "heap") && argc > 3) {
+            benchHeap(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "batch") && argc > 3) {
+            benchBatch(argv[2], stoul(argv[3]), argc > 4 ? stoul(argv[4]) : hardwareThreads());
+        } else if (!strcmp(argv[1], "engines") && argc > 3) {
+            benchEngines(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "lod")) {
+            benchLOD(argv[2]);
+        } else if (!strcmp(argv[1], "tiles") && argc > 3) {
+            benchTiles(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "cluster") && argc > 3) {
+            benchCluster(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "metrics") && argc > 3) {
+            benchMetrics(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "attributes") && argc > 3) {
+            const MeshData original = readMesh(argv[2]);
+            cout << argv[2] << " down to " << argv[3] << " faces" << endl;
+            benchAttributes<NormalQEF>("normal", original, stoul(argv[3]));
+            benchAttributes<TextureQEF>("uv", original, stoul(argv[3]));
+        } else if (!strcmp(argv[1], "simd")) {
+            cout << argv[2] << ", widest kernel " << simdLevelName(simdLevel()) << endl;
+            benchSIMD<DistanceQEF>("distance", argv[2]);
+            benchSIMD<PlaneQEF>("plane", argv[2]);
+            benchPlanes(argv[2]);
+        } else if (!strcmp(argv[1], "progressive") && argc > 3) {
+            benchProgressive(argv[2], stoul(argv[3]));
+        } else if (!strcmp(argv[1], "outofcore") && argc > 4) {
+            benchOutOfCore(argv[2], stoul(argv[3]), stoull(argv[4]));
+        } else {
+            cerr << "unknown benchmark " << argv[1] << endl;
+            return 1;
+        }
+    } catch (const string& error) {
+        cerr << error << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include "collapsible.h"
+#include "outofcore.h"
+#include "parallel.h"
+#include "threadpool.h"
+
+#include <algorithm>  // all_of, max, min, sort, transform
+#include <cctype>     // isdigit, tolower
+#include <chrono>     // steady_clock, duration
+#include <cstring>    // strcmp
+#include <exception>  // exception
+#include <filesystem> // path, directory_iterator, create_directories, file_size
+#include <iostream>   // cout, cerr, endl
+#include <mutex>      // mutex, lock_guard
+#include <set>        // set
+#include <string>     // string, stof, stoul, stoull
+#include <utility>    // pair
+#include <vector>     // vector
+
+using namespace std;
+
+
+// How every mesh gets simplified, unless its own target says otherwise
+struct Settings {
+    uint64_t faces = 2'000ul;
+    float ratio = 0.0f; // A fraction of each mesh's faces in place of a fixed count, when above 0
+    filesystem::path output;
+    unsigned jobs = hardwareThreads();
+    ErrorMetric metric = ErrorMetric::Distance;
+    bool useCache = true;
+    size_t memoryBudget = 0ul; // Bytes each mesh may take at once, meshes go through the out-of-core path when above 0
+};
+
+// One mesh to simplify, and where the result goes
+struct Job {
+    filesystem::path input, output;
+    uint64_t faces; // 0 to go by the settings
+    uintmax_t bytes;
+};
+
+// What the finished jobs add up to, printed as each one ends
+struct Summary {
+    mutex lock;
+    size_t meshes = 0ul, failed = 0ul;
+    uint64_t faces = 0ul;
+};
+
+static void usage(const char* program) {
+    cerr << "usage: " << program << " [options] <mesh|directory>[=faces]..." << endl
+         << "Simplifies every mesh given, and every .obj, .ply and .stl directly in each directory given, several at" << endl
+         << "once. Results are written as OBJ." << endl
+         << "  -f, --faces <n>       faces to leave in each mesh without a target of its own, 2000 by default" << endl
+         << "  -r, --ratio <r>       or this fraction of each mesh's faces" << endl
+         << "  -o, --output <dir>    write into dir rather than next to each input as <name>.simplified.obj" << endl
+         << "  -j, --jobs <n>        meshes simplified at once, one per core by default" << endl
+         << "  -m, --metric <name>   distance, plane, normal or uv, distance by default. normal and uv carry the mesh's" << endl
+         << "                        normals or texture coordinates through, the others drop them" << endl
+         << "      --memory-budget <bytes>" << endl
+         << "                        simplify out of core, holding no more than this much of each mesh at once" << endl
+         << "      --no-cache        neither read nor write the cache next to each input" << endl;
+}
+
+// Meshes this wrote on an earlier run are left out, or running it twice over a directory would simplify them again
+static bool isMesh(const filesystem::path& path) {
+    string extension = path.extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return tolower(c); });
+    return (extension == ".obj" || extension == ".ply" || extension == ".stl") && path.stem().extension() != ".simplified";
+}
+
+// Splits a trailing =faces off an argument, leaving any other = in the path alone
+static pair<string, uint64_t> parseTarget(const string& argument) {
+    const size_t equals = argument.rfind('=');
+    if (equals == string::npos || equals + 1ul == argument.size() ||
+        !all_of(argument.begin() + equals + 1ul, argument.end(), [](unsigned char c) { return isdigit(c); }))
+        return { argument, 0ul };
+    return { argument.substr(0ul, equals), stoull(argument.substr(equals + 1ul)) };
+}
+
+// Every mesh the inputs name, each with where its result goes
+static vector<Job> gatherJobs(const vector<string>& inputs, const Settings& settings) {
+    vector<Job> jobs;
+    auto add = [&](const filesystem::path& input, uint64_t faces) {
+        const filesystem::path output = settings.output.empty()
+            ? input.parent_path() / (input.stem().string() + ".simplified.obj")
+            : settings.output / (input.stem().string() + ".obj");
+        jobs.push_back({ input, output, faces, filesystem::file_size(input) });
+    };
+
+    for (const string &argument : inputs) {
+        const auto [input, faces] = parseTarget(argument);
+        if (filesystem::is_directory(input)) {
+            vector<filesystem::path> meshes;
+            for (const auto &entry : filesystem::directory_iterator(input))
+                if (entry.is_regular_file() && isMesh(entry.path()))
+                    meshes.push_back(entry.path());
+
+            sort(meshes.begin(), meshes.end());
+            for (const auto &mesh : meshes)
+                add(mesh, faces);
+        } else if (filesystem::is_regular_file(input)) {
+            add(input, faces);
+        } else {
+            throw "No mesh or directory named " + input;
+        }
+    }
+
+    set<filesystem::path> outputs;
+    for (const Job &job : jobs)
+        if (!outputs.insert(job.output).second)
+            throw "More than one mesh would be written to " + job.output.string();
+
+    return jobs;
+}
+
+static void simplifyMesh(const Job& job, const Settings& settings, Summary& summary) {
+    using Clock = chrono::steady_clock;
+    auto millis = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+    try {
+        const auto start = Clock::now();
+        Clock::time_point loaded, simplified;
+        uint64_t inputFaces = 0ul, outputFaces = 0ul;
+
+        if (settings.memoryBudget) {
+            // Loading, simplifying and writing are interleaved out of core, so only the total is timed
+            const OutOfCoreStats stats = simplifyOutOfCore(job.input.c_str(), job.output.c_str(), job.faces ? job.faces : settings.faces,
+                                                           settings.memoryBudget, nullptr, settings.metric);
+            const double total = millis(Clock::now() - start);
+
+            lock_guard lock(summary.lock);
+            ++summary.meshes;
+            summary.faces += stats.inputFaces;
+            cout << job.input.string() << ": " << stats.inputFaces << " -> " << stats.outputFaces << " faces out of core after "
+                 << stats.rounds << " rounds of slabs, " << total << "ms, " << static_cast<double>(stats.inputFaces) / total / 1000.0
+                 << "M faces/s" << endl;
+            return;
+        }
+
+        withMetric(settings.metric, [&](auto& mesh) {
+            loaded = Clock::now();
+            inputFaces = mesh.faceCount();
+
+            const uint64_t target = job.faces ? job.faces
+                : settings.ratio > 0.0f ? static_cast<uint64_t>(static_cast<double>(inputFaces) * settings.ratio)
+                : settings.faces;
+            mesh.simplify(target);
+            outputFaces = mesh.faceCount();
+            simplified = Clock::now();
+
+            writeOBJ(job.output.c_str(), mesh.exportMesh());
+        }, job.input.c_str(), LoadMode::Parallel, settings.useCache);
+        const auto written = Clock::now();
+
+        lock_guard lock(summary.lock);
+        ++summary.meshes;
+        summary.faces += inputFaces;
+        cout << job.input.string() << ": " << inputFaces << " -> " << outputFaces << " faces, load " << millis(loaded - start)
+             << "ms, simplify " << millis(simplified - loaded) << "ms, write " << millis(written - simplified) << "ms, "
+             << static_cast<double>(inputFaces) / millis(written - start) / 1000.0 << "M faces/s" << endl;
+    } catch (const string& error) {
+        lock_guard lock(summary.lock);
+        ++summary.failed;
+        cerr << job.input.string() << ": " << error << endl;
+    } catch (const exception& error) {
+        lock_guard lock(summary.lock);
+        ++summary.failed;
+        cerr << job.input.string() << ": " << error.what() << endl;
+    }
+}
+
+
+//////////
+// MAIN //
+//////////
+int main(int argc, char **argv) {
+    Settings settings;
+    vector<string> inputs;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const char *argument = argv[i];
+            auto value = [&]() -> string {
+                if (i + 1 == argc)
+                    throw string(argument) + " needs a value";
+                return argv[++i];
+            };
+
+            if (!strcmp(argument, "-f") || !strcmp(argument, "--faces")) {
+                settings.faces = stoull(value());
+            } else if (!strcmp(argument, "-r") || !strcmp(argument, "--ratio")) {
+                settings.ratio = stof(value());
+            } else if (!strcmp(argument, "-o") || !strcmp(argument, "--output")) {
+                settings.output = value();
+            } else if (!strcmp(argument, "-j") || !strcmp(argument, "--jobs")) {
+                settings.jobs = max(1ul, stoul(value()));
+            } else if (!strcmp(argument, "-m") || !strcmp(argument, "--metric")) {
+                const string metric = value();
+                if (metric == "distance")
+                    settings.metric = ErrorMetric::Distance;
+                else if (metric == "plane")
+                    settings.metric = ErrorMetric::Plane;
+                else if (metric == "normal")
+                    settings.metric = ErrorMetric::Normal;
+                else if (metric == "uv")
+                    settings.metric = ErrorMetric::Texture;
+                else
+                    throw "Unknown metric " + metric;
+            } else if (!strcmp(argument, "--memory-budget")) {
+                settings.memoryBudget = stoull(value());
+            } else if (!strcmp(argument, "--no-cache")) {
+                settings.useCache = false;
+            } else if (!strcmp(argument, "-h") || !strcmp(argument, "--help")) {
+                usage(argv[0]);
+                return 0;
+            } else if (argument[0] == '-' && argument[1] != '\0') {
+                throw string("Unknown option ") + argument;
+            } else {
+                inputs.push_back(argument);
+            }
+        }
+
+        if (inputs.empty()) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        // Out of core the face count is only known once the mesh has been streamed through
+        if (settings.memoryBudget && settings.ratio > 0.0f)
+            throw string("--ratio cannot be used with --memory-budget");
+
+        vector<Job> jobs = gatherJobs(inputs, settings);
+        if (!settings.output.empty())
+            filesystem::create_directories(settings.output);
+
+        // The pool starts jobs in the order they go in, so the biggest go first. A big mesh left to start near the end would
+        // keep one core busy after the rest have finished.
+        sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.bytes > b.bytes; });
+
+        Summary summary;
+        const auto start = chrono::steady_clock::now();
+        {
+            ThreadPool pool(min<size_t>(settings.jobs, max<size_t>(1ul, jobs.size())));
+            for (const Job &job : jobs)
+                pool.submit([&job, &settings, &summary] { simplifyMesh(job, settings, summary); });
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << summary.meshes << " meshes";
+        if (summary.failed)
+            cout << ", " << summary.failed << " failed";
+        cout << ", " << summary.faces << " faces in " << seconds << "s, "
+             << static_cast<double>(summary.faces) / seconds / 1e6 << "M faces/s" << endl;
+        return summary.failed ? 1 : 0;
+    } catch (const string& error) {
+        cerr << error << endl;
+        return 1;
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+}
@@ -1,8 +1,22 @@
 #include "collapsible.h"
 
-#include <iostream> // cout, endl
-#include <queue>    // priority_queue, greater
-#include <set>      // set
+#include "parallel.h"
+#include "progressive.h"
+#include "qefbatch.h"
+
+#include <algorithm>   // find, max, min, stable_sort
+#include <array>       // array, tuple_size_v
+#include <atomic>      // atomic, memory_order_relaxed
+#include <chrono>      // steady_clock
+#include <cmath>       // abs, copysign, sqrt
+#include <cstring>     // memcpy
+#include <fstream>     // ofstream
+#include <iostream>    // cout, endl
+#include <limits>      // numeric_limits
+#include <numeric>     // iota
+#include <random>      // mt19937_64
+#include <type_traits> // integral_constant, is_same_v, is_trivially_copyable_v
+#include <utility>     // index_sequence, make_index_sequence
 
 using namespace std;
 
@@ -13,14 +27,6 @@ using namespace std;
 DistanceQEF::DistanceQEF(float n, const f32v3& Sv, float Svtv) : n(n), Sv(Sv), Svtv(Svtv) {
 }
 
-DistanceQEF::DistanceQEF(Halfedge* he) : DistanceQEF() {
-    he->v->traverseEdges([&](Halfedge* it) {
-        ++n;
-        Sv += it->flip->v->pos;
-        Svtv += it->flip->v->pos.dot(it->flip->v->pos);
-    });
-}
-
 float DistanceQEF::evaluateErrorImpl(const f32v3& p) const {
     return n * p.dot(p) - 2 * p.dot(Sv) + Svtv;
 }
@@ -37,143 +43,1304 @@ DistanceQEF DistanceQEF::operator+(const DistanceQEF& qef) const {
 //////////////
 // PlaneQEF //
 //////////////
-PlaneQEF::PlaneQEF(const f32v3& Snnt012, const f32v3& Snnt458, const f32v3& Snd, float Sd)
+// Solves A x = b for the symmetric A with rows (a00 a01 a02) (a01 a11 a12) (a02 a12 a22), least norm x along any
+// direction A is too flat in. A well conditioned A, the common case, is inverted outright through its cofactors.
+static f32v3 solveSymmetric(float a00, float a01, float a02, float a11, float a12, float a22, const f32v3& b) {
+    const float c00 = a11 * a22 - a12 * a12, c01 = a02 * a12 - a01 * a22, c02 = a01 * a12 - a02 * a11;
+    const float c11 = a00 * a22 - a02 * a02, c12 = a01 * a02 - a00 * a12, c22 = a00 * a11 - a01 * a01;
+    const float det = a00 * c00 + a01 * c01 + a02 * c02, trace = a00 + a11 + a22;
+
+    // The determinant is the product of the eigenvalues and none is above the trace, so this bounds the smallest
+    if (det > PlaneQEF::rankTolerance * trace * trace * trace)
+        return f32v3{ c00 * b.x + c01 * b.y + c02 * b.z,
+                      c01 * b.x + c11 * b.y + c12 * b.z,
+                      c02 * b.x + c12 * b.y + c22 * b.z } / det;
+
+    // Otherwise take the pseudoinverse through an eigendecomposition, by Jacobi rotations as a 3x3 needs only a few
+    float m[3][3] = { { a00, a01, a02 }, { a01, a11, a12 }, { a02, a12, a22 } };
+    float v[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    constexpr int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+    for (int sweep = 0; sweep < 8; ++sweep) {
+        if (m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2] <= 1e-12f * trace * trace)
+            break;
+
+        for (const auto &[p, q] : pairs) {
+            if (m[p][q] == 0.0f)
+                continue;
+
+            // Rotate in the p q plane to zero m[p][q], taking the smaller of the two angles that do it
+            const float theta = (m[q][q] - m[p][p]) / (2.0f * m[p][q]);
+            const float t = copysign(1.0f, theta) / (abs(theta) + sqrt(theta * theta + 1.0f));
+            const float c = 1.0f / sqrt(t * t + 1.0f), s = t * c;
+
+            for (int k = 0; k < 3; ++k) {
+                const float mkp = m[k][p], mkq = m[k][q];
+                m[k][p] = c * mkp - s * mkq;
+                m[k][q] = s * mkp + c * mkq;
+            }
+            for (int k = 0; k < 3; ++k) {
+                const float mpk = m[p][k], mqk = m[q][k];
+                m[p][k] = c * mpk - s * mqk;
+                m[q][k] = s * mpk + c * mqk;
+            }
+            for (int k = 0; k < 3; ++k) {
+                const float vkp = v[k][p], vkq = v[k][q];
+                v[k][p] = c * vkp - s * vkq;
+                v[k][q] = s * vkp + c * vkq;
+            }
+        }
+    }
+
+    // Eigenvectors are the columns of v, and any direction too flat to trust is left out of the answer
+    const float largest = max({ m[0][0], m[1][1], m[2][2] });
+    f32v3 x = {};
+    for (int i = 0; i < 3; ++i) {
+        if (m[i][i] <= PlaneQEF::rankTolerance * largest)
+            continue;
+        const f32v3 axis = { v[0][i], v[1][i], v[2][i] };
+        x += axis * (axis.dot(b) / m[i][i]);
+    }
+    return x;
+}
+
+PlaneQEF::PlaneQEF(const f32v3& Snnt012, const f32v3& Snnt458, const f32v3& Snd, float Sd, const DistanceQEF& neighbors)
   : Snnt012(Snnt012)
   , Snnt458(Snnt458)
   , Snd(Snd)
-  , Sd2(Sd) {
+  , Sd2(Sd)
+  , neighbors(neighbors) {
 }
 
-PlaneQEF::PlaneQEF(Vertex* v) : PlaneQEF() {
-    v->traverseEdges([&](Halfedge* it) {
-        const f32v3 n_i = it->f->normal();
-        const float d_i = it->v->pos.dot(n_i);
-        Snnt012 += n_i * n_i.x;
-        Snnt458 += { n_i.y * n_i.y, n_i.y * n_i.z, n_i.z * n_i.z };
-        Snd += n_i * d_i;
-        Sd2 += d_i * d_i;
-    });
+void PlaneQEF::addPlane(const FacePlane& plane) {
+    // A degenerate face has no plane to keep the vertex on
+    const f32v3 &n = plane.n;
+    if (!(n.lengthSqr() > 0.5f))
+        return;
+
+    Snnt012 += n * n.x;
+    Snnt458 += { n.y * n.y, n.y * n.z, n.z * n.z };
+    Snd += n * plane.d;
+    Sd2 += plane.d * plane.d;
 }
 
 float PlaneQEF::evaluateErrorImpl(const f32v3& p) const {
-    return p.dot({ p.dot(Snnt012), p.dot(Snnt345()), p.dot(Snnt678())}) - 2.0f * p.dot(Snd) + Sd2;
+    return p.dot(multiply(p)) - 2.0f * p.dot(Snd) + Sd2 + tieWeight * neighbors.evaluateError(p);
 }
 
 f32v3 PlaneQEF::minimizeErrorImpl() const {
-    // NEED PSEUDOINVERSE
-    return {};
+    // Solve from the centroid, so whatever the planes leave free stays where the vertices are
+    const f32v3 centroid = neighbors.minimizeError();
+    return centroid + solveSymmetric(Snnt012.x, Snnt012.y, Snnt012.z, Snnt458.x, Snnt458.y, Snnt458.z, Snd - multiply(centroid));
 }
 
 PlaneQEF PlaneQEF::operator+(const PlaneQEF& qef) const {
-    return { Snnt012 + qef.Snnt012, Snnt458 + qef.Snnt458, Snd + qef.Snd, Sd2 + qef.Sd2 };
+    return { Snnt012 + qef.Snnt012, Snnt458 + qef.Snnt458, Snd + qef.Snd, Sd2 + qef.Sd2, neighbors + qef.neighbors };
 }
 
 
-/////////////
-// QEFEdge //
-/////////////
-void QEFEdge::updateQEF() {
-    qef = static_cast<QEFVertex*>(he->v)->qef + static_cast<QEFVertex*>(he->flip->v)->qef;
-    newPos = qef.minimizeError();
-    dirty = false;
+//////////////////
+// AttributeQEF //
+//////////////////
+// Calls op once for every j below N with j as a constant, so each attribute gets straight line code of its own
+template <size_t N, class Op>
+static constexpr void unrolled(Op&& op) {
+    [&]<size_t... j>(index_sequence<j...>) { (op(integral_constant<size_t, j>{}), ...); }(make_index_sequence<N>{});
+}
+
+template <size_t N>
+AttributeQEF<N>::AttributeQEF(const PlaneQEF& position, const array<f32v3, N>& Sg, const Attributes& Se, float faces)
+  : position(position)
+  , Sg(Sg)
+  , Se(Se)
+  , faces(faces) {
+}
+
+template <size_t N>
+void AttributeQEF<N>::addFace(const f32v3& p0, const f32v3& p1, const f32v3& p2, const Attributes& s0, const Attributes& s1, const Attributes& s2) {
+    const f32v3 e1 = p1 - p0, e2 = p2 - p0, n = e1.cross(e2);
+    const float nn = n.lengthSqr();
+
+    // A degenerate face has no plane to keep the vertex on, nor any direction for its attributes to vary along
+    const f32v3 unit = n / sqrt(nn);
+    if (!(unit.lengthSqr() > 0.5f))
+        return;
+    position.addPlane({ unit, unit.dot(p0) });
+
+    // Across the face each attribute is g . p + e, with the gradient g made of the attribute's differences along the
+    // two edges and their duals in the face's plane. The squared difference from that adds g g^T, -e g and e^2.
+    const f32v3 dual1 = e2.cross(n) / nn, dual2 = n.cross(e1) / nn;
+    unrolled<N>([&](auto j) {
+        const f32v3 g = dual1 * (s1[j] - s0[j]) + dual2 * (s2[j] - s0[j]);
+        const float e = s0[j] - g.dot(p0);
+
+        position.Snnt012 += g * g.x;
+        position.Snnt458 += { g.y * g.y, g.y * g.z, g.z * g.z };
+        position.Snd -= g * e;
+        position.Sd2 += e * e;
+        Sg[j] += g;
+        Se[j] += e;
+    });
+    faces += 1.0f;
 }
 
-bool QEFEdge::checkSafety() const {
-    // Compute neighborhood of vertices touching one side of prospective edge, less the vertices on its faces
-    set<Vertex*> neighbors;
-    bool hasOtherNeighbors = false;
+// The best attributes anywhere are the mean of the faces' prediction there, (Se + Sg . p) / faces. Putting them back
+// in subtracts Sg Sg^T / faces, adds Se Sg / faces and subtracts Se^2 / faces per attribute.
+template <size_t N>
+PlaneQEF AttributeQEF<N>::eliminated() const {
+    PlaneQEF reduced = position;
+    if (!(faces > 0.0f))
+        return reduced;
 
-    for (Halfedge *it = he->flip->next->flip->next; it != he->prev->flip; it = it->flip->next) {
-        neighbors.insert(it->flip->v);
+    const float inverse = 1.0f / faces;
+    unrolled<N>([&](auto j) {
+        const f32v3 g = Sg[j] * inverse;
+        reduced.Snnt012 -= Sg[j] * g.x;
+        reduced.Snnt458 -= { Sg[j].y * g.y, Sg[j].y * g.z, Sg[j].z * g.z };
+        reduced.Snd += g * Se[j];
+        reduced.Sd2 -= Se[j] * Se[j] * inverse;
+    });
+    return reduced;
+}
+
+template <size_t N>
+float AttributeQEF<N>::evaluateErrorImpl(const f32v3& p) const {
+    return eliminated().evaluateError(p);
+}
+
+template <size_t N>
+f32v3 AttributeQEF<N>::minimizeErrorImpl() const {
+    return eliminated().minimizeError();
+}
+
+template <size_t N>
+auto AttributeQEF<N>::attributesAtImpl(const f32v3& p) const -> Attributes {
+    Attributes attributes = {};
+    if (faces > 0.0f)
+        unrolled<N>([&](auto j) { attributes[j] = (Se[j] + Sg[j].dot(p)) / faces; });
+    return attributes;
+}
+
+template <size_t N>
+AttributeQEF<N> AttributeQEF<N>::operator+(const AttributeQEF& qef) const {
+    AttributeQEF sum = { position + qef.position, Sg, Se, faces + qef.faces };
+    unrolled<N>([&](auto j) {
+        sum.Sg[j] += qef.Sg[j];
+        sum.Se[j] += qef.Se[j];
+    });
+    return sum;
+}
+
+
+/////////////////
+// Collapsible //
+/////////////////
+template <class QEF>
+BasicCollapsible<QEF>::BasicCollapsible(const char* meshfile, LoadMode mode, bool useCache) {
+    static_assert(is_trivially_copyable_v<QEF>, "QEFs are cached as raw bytes");
+
+    // The cache keeps positions and connectivity only, a metric that carries attributes has to read them again
+    useCache = useCache && !carriesAttributes<QEF>;
+
+    if (MeshCache cache; useCache && cache.open(meshfile, sizeof(QEF))) {
+        // Connectivity and vertex QEFs come straight out of the cache
+        buildFromCache(cache);
+        buildPlanes();
+
+        const char *qef = static_cast<const char*>(cache.qefs());
+        for (auto &vertex : m_vertices) {
+            memcpy(&vertex.qef, qef, sizeof(QEF));
+            qef += sizeof(QEF);
+        }
+    } else {
+        {
+            const MeshData mesh = readMesh(meshfile, mode);
+            build(mesh);
+            loadAttributes(mesh);
+        }
+        buildPlanes();
+        buildVertexQEFs();
+
+        if (useCache) {
+            // Best effort, an unwritable directory just means parsing next time too
+            vector<QEF> qefs;
+            qefs.reserve(m_vertices.size());
+            for (const auto &vertex : m_vertices)
+                qefs.push_back(vertex.qef);
+
+            MeshCache::Writer writer = startCache(meshfile, sizeof(QEF));
+            writer.section(qefs.data(), qefs.size() * sizeof(QEF));
+            writer.finish();
+        }
+    }
+
+    parallelBlocks(m_edges.size(), [&](size_t begin, size_t end) {
+        updateEdges(begin, end, [](const QEFEdge<QEF>&) { return true; });
+    });
+}
+
+template <class QEF>
+BasicCollapsible<QEF>::BasicCollapsible(const MeshData& mesh)
+  : Base(mesh) {
+    loadAttributes(mesh);
+    buildPlanes();
+    buildVertexQEFs();
+
+    parallelBlocks(m_edges.size(), [&](size_t begin, size_t end) {
+        updateEdges(begin, end, [](const QEFEdge<QEF>&) { return true; });
+    });
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::sumQEF(QEFEdge<QEF>& edge) const {
+    const Halfedge &he = m_halfedges[edge.he];
+    edge.qef = m_vertices[he.v].qef + m_vertices[head(edge.he)].qef;
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::updateQEF(QEFEdge<QEF>& edge) const {
+    sumQEF(edge);
+    edge.newPos = edge.qef.minimizeError();
+    edge.cost = edge.qef.evaluateError(edge.newPos);
+}
+
+template <class QEF>
+bool BasicCollapsible<QEF>::locked(const QEFEdge<QEF>& edge) const {
+    return m_vertices[m_halfedges[edge.he].v].locked || m_vertices[head(edge.he)].locked;
+}
+
+template <class QEF>
+bool BasicCollapsible<QEF>::checkSafety(const QEFEdge<QEF>& edge) const {
+    // Compute neighborhood of vertices touching one side of prospective edge, less the vertices on its faces.
+    // Valences are small enough that scanning a fixed buffer beats any set, a ring too big for it is walked again instead.
+    const Halfedge &he = m_halfedges[edge.he], &flip = m_halfedges[he.flip];
+    const uint32_t first = nextAround(flip.next), last = m_halfedges[he.prev].flip;
+    array<uint32_t, 32> neighbors;
+    size_t neighborCount = 0ul;
+    bool hasOtherNeighbors = false, overflowed = false;
+
+    for (uint32_t it = first; it != last; it = nextAround(it)) {
+        if (neighborCount < neighbors.size())
+            neighbors[neighborCount++] = head(it);
+        else
+            overflowed = true;
         hasOtherNeighbors = true;
     }
 
+    auto isNeighbor = [&](uint32_t v) {
+        if (find(neighbors.begin(), neighbors.begin() + neighborCount, v) != neighbors.begin() + neighborCount)
+            return true;
+        if (overflowed)
+            for (uint32_t it = first; it != last; it = nextAround(it))
+                if (head(it) == v)
+                    return true;
+        return false;
+    };
+
     // Check the neighborhood on the other side for any matches
-    for (Halfedge *it = he->next->flip->next; it != he->flip->prev->flip; it = it->flip->next) {
-        if (neighbors.contains(it->flip->v))
+    for (uint32_t it = nextAround(he.next); it != m_halfedges[flip.prev].flip; it = nextAround(it)) {
+        if (isNeighbor(head(it)))
             return false;
         hasOtherNeighbors = true;
     }
 
     // Allow collpase if there are neighbors, or if either side of this edge is not a triangle
-    return hasOtherNeighbors || (!he->f->isTriangle() || !he->flip->f->isTriangle());
+    return hasOtherNeighbors || (!isTriangle(he.f) || !isTriangle(flip.f));
 }
 
-size_t QEFEdge::collapse() {
-    // Get the new point and update its position and QEF before altering the topology and losing the pointer
-    QEFVertex *remaining = static_cast<QEFVertex*>(he->v);
-    remaining->qef = qef;
-    remaining->pos = newPos;
+template <class QEF>
+uint64_t BasicCollapsible<QEF>::collapse(QEFEdge<QEF>& edge) {
+    // Get the new point and update its position and QEF before altering the topology and losing the handle
+    QEFVertex<QEF> &remaining = m_vertices[m_halfedges[edge.he].v];
+    remaining.qef = edge.qef;
+    remaining.attributes = edge.qef.attributesAt(edge.newPos);
+    remaining.pos = edge.newPos;
 
     // Collapse the triangle and report how many faces we removed
-    return he->collapse();
+    return Base::collapse(edge.he);
 }
 
+template <class QEF>
+void BasicCollapsible<QEF>::buildPlanes() {
+    if constexpr (is_same_v<QEF, PlaneQEF>) {
+        m_planes.resize(m_faces.size());
+        parallelBlocks(m_faces.size(), [&](size_t begin, size_t end) {
+            PlaneBatch batch;
+            array<uint32_t, PlaneBatch::capacity> faces;
 
-/////////////////
-// Collapsible //
-/////////////////
-Collapsible::Collapsible(const char* objfile)
-  : Manifold(objfile)
-  , m_removedCount(0ul) {
+            auto solve = [&] {
+                planeBatch(batch);
+                for (size_t i = 0ul; i < batch.count; ++i)
+                    m_planes[faces[i]] = batch[i];
+                batch.count = 0ul;
+            };
+
+            for (size_t i = begin; i < end; ++i) {
+                if (!m_faces[i].invalid()) {
+                    const Halfedge &a = m_halfedges[m_faces[i].he], &b = m_halfedges[a.next], &c = m_halfedges[b.next];
+                    faces[batch.count] = static_cast<uint32_t>(i);
+                    batch.push(m_vertices[a.v].pos, m_vertices[b.v].pos, m_vertices[c.v].pos, m_vertices[m_halfedges[c.next].v].pos);
+                    if (batch.full())
+                        solve();
+                }
+            }
+            solve();
+        });
+    }
+}
+
+// The channel of a mesh an attribute metric carries, normals in three dimensions and texture coordinates in two
+template <size_t N, class Mesh>
+static auto& attributeChannel(Mesh& mesh) {
+    static_assert(N == 2ul || N == 3ul, "Attributes are either normals or texture coordinates");
+    if constexpr (N == 3ul)
+        return mesh.normals;
+    else
+        return mesh.uvs;
+}
+
+// Attributes to and from the vector type their channel keeps them in
+static array<float, 3> attributesOf(const f32v3& value) { return { value.x, value.y, value.z }; }
+static array<float, 2> attributesOf(const f32v2& value) { return { value.x, value.y }; }
+static f32v3 valueOf(const array<float, 3>& attributes) { return { attributes[0], attributes[1], attributes[2] }; }
+static f32v2 valueOf(const array<float, 2>& attributes) { return { attributes[0], attributes[1] }; }
+
+template <class QEF>
+void BasicCollapsible<QEF>::loadAttributes(const MeshData& mesh) {
+    if constexpr (carriesAttributes<QEF>) {
+        constexpr size_t N = tuple_size_v<typename QEF::Attributes>;
+        const auto &channel = attributeChannel<N>(mesh);
+        if (channel.size() != mesh.positions.size())
+            throw string(N == 3ul ? "The mesh has no normals" : "The mesh has no texture coordinates") + " to simplify with";
+
+        // Scaled once here and back on the way out, so QEFs only ever see them in the units of positions
+        m_attributeScale = QEF::attributeScale * getAABBSizes().length();
+        if (!(m_attributeScale > 0.0f))
+            m_attributeScale = 1.0f;
+
+        parallelFor(m_vertices.size(), [&](size_t i) {
+            m_vertices[i].attributes = attributesOf(channel[i] * m_attributeScale);
+        });
+    }
+}
+
+template <class QEF>
+MeshData BasicCollapsible<QEF>::exportMesh() const {
+    MeshData mesh = Base::exportMesh();
+
+    if constexpr (carriesAttributes<QEF>) {
+        constexpr size_t N = tuple_size_v<typename QEF::Attributes>;
+        auto &channel = attributeChannel<N>(mesh);
+        channel.reserve(mesh.positions.size());
+
+        for (const auto &vertex : m_vertices) {
+            if (vertex.invalid())
+                continue;
+
+            auto &value = channel.emplace_back(valueOf(vertex.attributes) / m_attributeScale);
+
+            // Blended normals come out short, so they are put back to unit length
+            if constexpr (N == 3ul)
+                if (value.lengthSqr() > 0.0f)
+                    value = value.normalize();
+        }
+    }
+
+    return mesh;
+}
+
+// Each vertex's QEF only reads the faces around it
+template <class QEF>
+void BasicCollapsible<QEF>::buildVertexQEFs() {
+    parallelFor(m_vertices.size(), [&](size_t i) {
+        const uint32_t v = static_cast<uint32_t>(i);
+        if constexpr (is_same_v<QEF, PlaneQEF>)
+            m_vertices[i].qef = { *this, v, [&](uint32_t f) { return m_planes[f]; } };
+        else if constexpr (carriesAttributes<QEF>)
+            m_vertices[i].qef = { *this, v, [&](uint32_t corner) { return m_vertices[corner].attributes; } };
+        else
+            m_vertices[i].qef = { *this, v };
+    });
+}
+
+// Collapses running side by side never share a face, so neither do their updates
+template <class QEF>
+void BasicCollapsible<QEF>::updatePlanes(uint32_t v) {
+    if constexpr (is_same_v<QEF, PlaneQEF>)
+        for (uint32_t he : outgoing(v))
+            m_planes[m_halfedges[he].f] = FacePlane(*this, m_halfedges[he].f);
+}
+
+template <class QEF>
+template <class Keep>
+void BasicCollapsible<QEF>::updateEdges(size_t begin, size_t end, Keep keep) {
+    if constexpr (!batched<QEF>) {
+        for (size_t i = begin; i < end; ++i)
+            if (QEFEdge<QEF> &edge = m_edges[i]; keep(edge))
+                updateQEF(edge);
+    } else {
+        QEFBatch<QEF> batch;
+        array<QEFEdge<QEF>*, QEFBatch<QEF>::capacity> edges;
+
+        auto solve = [&] {
+            minimizeBatch(batch);
+            for (size_t i = 0ul; i < batch.count; ++i) {
+                edges[i]->newPos = batch.point(i);
+                edges[i]->cost = batch.error[i];
+            }
+            batch.count = 0ul;
+        };
+
+        for (size_t i = begin; i < end; ++i) {
+            if (QEFEdge<QEF> &edge = m_edges[i]; keep(edge)) {
+                sumQEF(edge);
+                edges[batch.count] = &edge;
+                batch.push(edge.qef);
+                if (batch.full())
+                    solve();
+            }
+        }
+        solve();
+    }
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::lockVertices(const vector<bool>& locked) {
+    auto flag = locked.begin();
     for (auto &vertex : m_vertices)
-        vertex.qef = { vertex.he };
+        if (flag != locked.end())
+            vertex.locked = *flag++;
+}
 
-    for (auto &edge : m_edges)
-        edge.updateQEF();
+template <class QEF>
+vector<bool> BasicCollapsible<QEF>::lockedVertices() const {
+    vector<bool> locked;
+    for (const auto &vertex : m_vertices)
+        if (!vertex.invalid())
+            locked.push_back(vertex.locked);
+    return locked;
 }
 
-void Collapsible::simplify(uint64_t finalCount) {
-    struct EdgeRef {
-        QEFEdge *e;
-        float error;
+template <class QEF>
+struct BasicCollapsible<QEF>::Collapse {
+    uint32_t remaining; // The merged vertex, noHandle for a collapse that never happened
+    QEFEdge<QEF> *condemned[2];
+    uint64_t removedFaces;
+};
 
-        EdgeRef(QEFEdge *e): e(e), error(e->qef.evaluateError(e->newPos)) {}
+// Collapses the edge and refreshes the errors around the merged vertex, touching nothing outside the faces around its ends
+template <class QEF>
+auto BasicCollapsible<QEF>::collapseEdge(QEFEdge<QEF>& edge) -> Collapse {
+    // A triangle on either side takes one of its other edges down with it
+    const Halfedge &he = m_halfedges[edge.he];
+    Collapse result = { he.v, { &m_edges[m_halfedges[he.next].e], &m_edges[m_halfedges[m_halfedges[he.flip].next].e] }, 0ul };
+    result.removedFaces = collapse(edge);
+
+    // Errors around the merged vertex have grown, only queued edges and those waiting to become safe care
+    for (uint32_t it : outgoing(result.remaining))
+        if (QEFEdge<QEF> &neighbor = m_edges[m_halfedges[it].e]; neighbor.queueSlot != EdgeHeap<QEF>::npos || neighbor.unsafe)
+            updateQEF(neighbor);
+
+    return result;
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::requeue(EdgeHeap<QEF>& errors, const Collapse& collapse) {
+    for (QEFEdge<QEF> *edge : collapse.condemned)
+        if (edge->invalid() && errors.contains(edge))
+            errors.remove(edge);
+
+    // The merged vertex's neighborhood may have become safe, so set-aside edges get another chance
+    for (uint32_t it : outgoing(collapse.remaining)) {
+        QEFEdge<QEF> *edge = &m_edges[m_halfedges[it].e];
+        if (errors.contains(edge)) {
+            errors.update(edge, edge->error());
+        } else if (edge->unsafe) {
+            edge->unsafe = false;
+            errors.push(edge, edge->error());
+        }
+    }
+}
+
+// Every live edge clear of locked vertices, in arena order
+template <class QEF>
+vector<QEFEdge<QEF>*> BasicCollapsible<QEF>::queueable() {
+    vector<QEFEdge<QEF>*> result;
+    result.reserve(m_edges.size());
+    for (QEFEdge<QEF> &e : m_edges)
+        if (!e.invalid() && !locked(e))
+            result.push_back(&e);
+    return result;
+}
+
+// Queues edges all at once, their errors evaluated across threads and then heapified together, so the queue comes out
+// the same however the work was split
+template <class QEF>
+static void fillQueue(EdgeHeap<QEF>& errors, const vector<QEFEdge<QEF>*>& edges, unsigned threads = hardwareThreads()) {
+    vector<float> keys(edges.size());
+    parallelFor(edges.size(), [&](size_t i) {
+        edges[i]->unsafe = false;
+        keys[i] = edges[i]->error();
+    }, threads);
+    errors.assign(edges, keys);
+}
+
+template <class QEF>
+struct BasicCollapsible<QEF>::Progress {
+    // Steps between reads of the clock, a collapse costs enough that this hides them completely
+    static constexpr uint32_t clockInterval = 64u;
+
+    explicit Progress(const SimplifyOptions& options)
+      : maxError(options.maxError)
+      , timed(options.timeBudget != chrono::steady_clock::duration::max())
+      , deadline(timed ? chrono::steady_clock::now() + options.timeBudget : chrono::steady_clock::time_point::max()) {
+    }
+
+    bool stopped() const { return result.reason == StopReason::MaxError || result.reason == StopReason::TimeBudget; }
+
+    // Counts a step and says whether to stop before taking it, nextError being the cheapest the step can do
+    bool halt(float nextError = 0.0f) {
+        if (stopped())
+            return true;
+
+        if (nextError > maxError)
+            result.reason = StopReason::MaxError;
+        else if (timed && ++steps % clockInterval == 0u && chrono::steady_clock::now() >= deadline)
+            result.reason = StopReason::TimeBudget;
+        return stopped();
+    }
+
+    // Closes the step towards target, saying why it ended
+    const SimplifyResult& reached(uint64_t target, uint64_t faces, const QueueStats& queue) {
+        result.queue = queue;
+        if (!stopped())
+            result.reason = faces <= target ? StopReason::FaceCount : passedOver ? StopReason::MaxError : StopReason::Exhausted;
+        return result;
+    }
+
+    const float maxError;
+    const bool timed;
+    const chrono::steady_clock::time_point deadline;
+    uint32_t steps = 0u;
+
+    bool passedOver = false; // Some edge was set aside for costing too much rather than stopping everything
+    SimplifyResult result;
+};
+
+template <class QEF>
+SimplifyResult BasicCollapsible<QEF>::simplify(uint64_t finalCount, const SimplifyOptions& options) {
+    SimplifyResult result;
+    for (const SimplifyResult &step : stepThrough({ finalCount }, options))
+        result = step;
+    return result;
+}
+
+template <class QEF>
+vector<MeshData> BasicCollapsible<QEF>::simplify(const vector<uint64_t>& targets, const SimplifyOptions& options) {
+    // Visit the targets largest first, then hand the snapshots back in the order they were asked for
+    vector<size_t> order(targets.size());
+    iota(order.begin(), order.end(), 0ul);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return targets[a] > targets[b]; });
+
+    vector<uint64_t> descending;
+    descending.reserve(targets.size());
+    for (size_t i : order)
+        descending.push_back(targets[i]);
+
+    vector<MeshData> snapshots, lods(targets.size());
+    snapshots.reserve(targets.size());
+    for ([[maybe_unused]] const SimplifyResult &step : stepThrough(descending, options))
+        snapshots.push_back(exportMesh());
+
+    // A run that stops early leaves every target after it at the mesh it stopped with
+    while (!snapshots.empty() && snapshots.size() < targets.size())
+        snapshots.push_back(snapshots.back());
+
+    for (size_t i = 0ul; i < order.size(); ++i)
+        lods[order[i]] = std::move(snapshots[i]);
+    return lods;
+}
+
+template <class QEF>
+Generator<SimplifyResult> BasicCollapsible<QEF>::simplifySteps(uint64_t finalCount, uint64_t stride, const SimplifyOptions& options) {
+    stride = max(1ul, stride);
+
+    vector<uint64_t> targets;
+    for (uint64_t faces = faceCount(); faces > finalCount + stride; faces -= stride)
+        targets.push_back(faces - stride);
+    targets.push_back(finalCount);
+
+    return stepThrough(std::move(targets), options);
+}
 
-        auto operator<=>(const EdgeRef& o) const { return error <=> o.error; }
+template <class QEF>
+Generator<SimplifyResult> BasicCollapsible<QEF>::stepThrough(vector<uint64_t> targets, SimplifyOptions options) {
+    // The budget covers building the queue too
+    Progress progress(options);
+
+    // Collapses left out of the history would make it impossible to replay
+    m_history.resize(options.record ? m_applied : 0ul);
+    m_recording = options.record;
+
+    // Whether the steps run out or the caller abandons them partway, everything collapsed so far is kept
+    struct Settle {
+        BasicCollapsible &mesh;
+        ~Settle() { mesh.m_applied = mesh.m_history.size(); mesh.m_recording = false; }
+    } settle{ *this };
+
+    // Clustering never passes the first target, so every snapshot of a chain comes out of the ordered collapses
+    if (options.clusterRatio > 0.0f && !targets.empty())
+        clusterCells(max(targets.front(), static_cast<uint64_t>(static_cast<double>(targets.back()) * options.clusterRatio)), progress);
+
+    auto engine = options.engine == SimplifyEngine::MultipleChoice ? collapseSampled(targets, options, progress)
+                : options.engine == SimplifyEngine::Tiled          ? collapseTiled(targets, options, progress)
+                                                                   : collapseQueued(targets, options, progress);
+    for (const SimplifyResult &step : engine)
+        co_yield step;
+
+#ifndef NDEBUG
+    verifyConnections();
+#endif
+}
+
+template <class QEF>
+Generator<SimplifyResult> BasicCollapsible<QEF>::collapseQueued(vector<uint64_t> targets, SimplifyOptions options, Progress& progress) {
+    // Populate the priority queue, edges touching a locked vertex never enter it
+    EdgeHeap<QEF> errors;
+    fillQueue(errors, queueable());
+
+    // One queue carries on through every target
+    for (uint64_t finalCount : targets) {
+        if (options.batchSize > 1ul)
+            collapseInBatches(errors, finalCount, options, progress);
+        else
+            m_removedFaces += collapseInOrder(errors, faceCount(), finalCount, progress, m_history);
+
+        co_yield progress.reached(finalCount, faceCount(), errors.stats());
+        if (progress.result.reason != StopReason::FaceCount)
+            co_return;
+    }
+}
+
+// Each target is reached by tiles simplifying side by side, then one queue over the whole mesh for the seams between them
+template <class QEF>
+Generator<SimplifyResult> BasicCollapsible<QEF>::collapseTiled(vector<uint64_t> targets, SimplifyOptions options, Progress& progress) {
+    const unsigned tiles = options.threads ? options.threads : hardwareThreads();
+
+    QueueStats stats;
+    for (uint64_t finalCount : targets) {
+        if (faceCount() > finalCount) {
+            const QueueStats tiled = collapseInTiles(finalCount, tiles, progress);
+
+            EdgeHeap<QEF> seams;
+            fillQueue(seams, queueable());
+            m_removedFaces += collapseInOrder(seams, faceCount(), finalCount, progress, m_history);
+
+            stats.pushes += tiled.pushes + seams.stats().pushes;
+            stats.pops += tiled.pops + seams.stats().pops;
+            stats.updates += tiled.updates + seams.stats().updates;
+            stats.removals += tiled.removals + seams.stats().removals;
+            stats.peakSize = max({ stats.peakSize, tiled.peakSize, seams.stats().peakSize });
+        }
+
+        co_yield progress.reached(finalCount, faceCount(), stats);
+        if (progress.result.reason != StopReason::FaceCount)
+            co_return;
+    }
+}
+
+// Cuts the mesh into slabs along its longest axis, each with about the same number of faces, and simplifies every slab
+// on its own thread towards its share of finalCount. A collapse rewrites the faces around both of its ends and the vertices
+// on them, so any vertex sharing a face with a vertex on a seam is frozen. No two tiles then ever touch the same element,
+// and their histories can simply be laid end to end.
+template <class QEF>
+QueueStats BasicCollapsible<QEF>::collapseInTiles(uint64_t finalCount, unsigned tiles, Progress& progress) {
+    tiles = static_cast<unsigned>(min<uint64_t>({ tiles, numeric_limits<uint16_t>::max() - 1u, max<uint64_t>(1ul, faceCount()) }));
+
+    // Balance the slabs on a histogram of face centroids
+    const f32v3 sizes = getAABBSizes(), origin = getAABBCentroid() - sizes * 0.5f;
+    const int axis = sizes.x >= sizes.y && sizes.x >= sizes.z ? 0 : sizes.y >= sizes.z ? 1 : 2;
+    const float width = max((&sizes.x)[axis], numeric_limits<float>::min());
+
+    constexpr size_t binCount = 4096ul;
+    vector<uint32_t> binOfFace(m_faces.size());
+    vector<uint64_t> bins(binCount, 0ul);
+    for (size_t i = 0ul; i < m_faces.size(); ++i) {
+        if (!m_faces[i].invalid()) {
+            const f32v3 centroid = this->centroid(static_cast<uint32_t>(i));
+            const float coordinate = ((&centroid.x)[axis] - (&origin.x)[axis]) / width;
+            // Written so a coordinate that is not a number lands in the first bin rather than in the cast
+            binOfFace[i] = static_cast<uint32_t>(max(0.0f, min(coordinate * binCount, static_cast<float>(binCount - 1ul))));
+            ++bins[binOfFace[i]];
+        }
+    }
+
+    vector<uint16_t> tileOfBin(binCount);
+    for (size_t bin = 0ul, seen = 0ul; bin < binCount; ++bin) {
+        tileOfBin[bin] = static_cast<uint16_t>(min<uint64_t>(tiles - 1u, seen * tiles / faceCount()));
+        seen += bins[bin];
+    }
+    auto tileOf = [&](uint32_t f) { return tileOfBin[binOfFace[f]]; };
+
+    // A vertex whose faces fall in more than one tile is on a seam
+    constexpr uint16_t seam = numeric_limits<uint16_t>::max();
+    vector<uint16_t> tileOfVertex(m_vertices.size(), seam);
+    parallelFor(m_vertices.size(), [&](size_t i) {
+        if (m_vertices[i].invalid())
+            return;
+        tileOfVertex[i] = tileOf(m_halfedges[m_vertices[i].he].f);
+        for (uint32_t out : outgoing(static_cast<uint32_t>(i)))
+            if (tileOf(m_halfedges[out].f) != tileOfVertex[i])
+                tileOfVertex[i] = seam;
+    });
+
+    vector<char> frozen(m_vertices.size(), false);
+    parallelFor(m_vertices.size(), [&](size_t i) {
+        if (!m_vertices[i].invalid() && !m_vertices[i].locked)
+            for (uint32_t out : outgoing(static_cast<uint32_t>(i)))
+                for (uint32_t corner : perimeter(m_halfedges[out].f))
+                    if (tileOfVertex[m_halfedges[corner].v] == seam)
+                        frozen[i] = true;
+    });
+    for (size_t i = 0ul; i < m_vertices.size(); ++i)
+        m_vertices[i].locked = m_vertices[i].locked || frozen[i];
+
+    // Hand out the edges and faces. Frozen faces wait for the seam pass, so each tile keeps its own and takes the free ones
+    // down to their share of finalCount. Asking tiles to make up for their seams would leave the inside of a tile too coarse.
+    vector<vector<QEFEdge<QEF>*>> edgesOfTile(tiles);
+    vector<uint64_t> facesOfTile(tiles, 0ul), frozenOfTile(tiles, 0ul);
+    for (QEFEdge<QEF> &e : m_edges)
+        if (!e.invalid() && !locked(e))
+            edgesOfTile[tileOf(m_halfedges[e.he].f)].push_back(&e);
+    for (uint32_t f = 0u; f < m_faces.size(); ++f) {
+        if (!m_faces[f].invalid()) {
+            ++facesOfTile[tileOf(f)];
+            for (uint32_t corner : perimeter(f)) {
+                if (frozen[m_halfedges[corner].v]) {
+                    ++frozenOfTile[tileOf(f)];
+                    break;
+                }
+            }
+        }
+    }
+    uint64_t freeFaces = 0ul;
+    for (size_t tile = 0ul; tile < tiles; ++tile)
+        freeFaces += facesOfTile[tile] - frozenOfTile[tile];
+
+    // Each tile's queue and history are made on the thread that uses them, so they land in its own memory
+    vector<uint64_t> removed(tiles, 0ul);
+    vector<vector<VertexSplit<QEF>>> histories(tiles);
+    vector<QueueStats> stats(tiles);
+    vector<SimplifyResult> outcomes(tiles);
+    parallelFor(tiles, [&](size_t tile) {
+        // Every tile already has a thread of its own
+        EdgeHeap<QEF> errors;
+        fillQueue(errors, edgesOfTile[tile], 1u);
+        edgesOfTile[tile] = {};
+
+        Progress own = progress;
+        const uint64_t share = finalCount * (facesOfTile[tile] - frozenOfTile[tile]) / max(1ul, freeFaces);
+        removed[tile] = collapseInOrder(errors, facesOfTile[tile], frozenOfTile[tile] + share, own, histories[tile]);
+        stats[tile] = errors.stats();
+        outcomes[tile] = own.result;
+    }, tiles);
+
+    QueueStats total;
+    for (size_t tile = 0ul; tile < tiles; ++tile) {
+        m_removedFaces += removed[tile];
+        m_history.insert(m_history.end(), histories[tile].begin(), histories[tile].end());
+        progress.result.lastError = max(progress.result.lastError, outcomes[tile].lastError);
+        if (outcomes[tile].reason == StopReason::MaxError || outcomes[tile].reason == StopReason::TimeBudget)
+            progress.result.reason = outcomes[tile].reason;
+
+        total.pushes += stats[tile].pushes;
+        total.pops += stats[tile].pops;
+        total.updates += stats[tile].updates;
+        total.removals += stats[tile].removals;
+        total.peakSize += stats[tile].peakSize;
+    }
+
+    // Thaw the seams. Their edges never sat in a queue, so their errors are as old as the tiles' first collapses.
+    for (size_t i = 0ul; i < m_vertices.size(); ++i)
+        if (frozen[i])
+            m_vertices[i].locked = false;
+    parallelBlocks(m_edges.size(), [&](size_t begin, size_t end) {
+        updateEdges(begin, end, [&](const QEFEdge<QEF>& e) {
+            return !e.invalid() && (frozen[m_halfedges[e.he].v] || frozen[head(e.he)]);
+        });
+    });
+
+    return total;
+}
+
+// Each step draws a few edges at random and collapses the cheapest, so errors only need refreshing where collapses happen
+template <class QEF>
+Generator<SimplifyResult> BasicCollapsible<QEF>::collapseSampled(vector<uint64_t> targets, SimplifyOptions options, Progress& progress) {
+    EdgePool<QEF> candidates;
+    candidates.reserve(m_edges.size());
+    for (QEFEdge<QEF> &e : m_edges) {
+        if (!e.invalid() && !locked(e)) {
+            e.unsafe = false;
+            candidates.push(&e);
+        }
+    }
+
+    // The pool only counts what goes in and out of it
+    uint64_t draws = 0ul;
+    auto stats = [&] {
+        QueueStats stats = candidates.stats();
+        stats.pops = draws;
+        return stats;
     };
 
-    // Populate the priority queue
-    priority_queue<EdgeRef, vector<EdgeRef>, greater<EdgeRef>> errors;
-    for (QEFEdge &e : m_edges)
-        errors.push({ &e });
-
-    // The heart of the algorithm
-    const uint64_t delta = m_faces.size() - finalCount;
-    while (m_removedCount < delta && !errors.empty()) {
-        QEFEdge *top = errors.top().e;
-        errors.pop();
-
-        if (top->invalid()) {
-            // This edge has been deleted during a collapse, remove it from queue
-        } else if (top->dirty) {
-            // Error has been increased, recalculate it
-            top->updateQEF();
-            errors.push({ top });
-        } else if (!top->checkSafety()) {
+    mt19937_64 random(options.seed);
+    for (uint64_t finalCount : targets) {
+        while (faceCount() > finalCount && !candidates.empty() && !progress.halt()) {
+            QEFEdge<QEF> *best = nullptr;
+            float bestError = numeric_limits<float>::max();
+            for (unsigned sample = 0u; sample < max(1u, options.samples); ++sample) {
+                // Multiply and shift maps the draw onto the pool without a division
+                QEFEdge<QEF> *edge = candidates[static_cast<size_t>((random() >> 32u) * candidates.size() >> 32u)];
+                if (const float error = edge->error(); error < bestError || !best) {
+                    best = edge;
+                    bestError = error;
+                }
+            }
+            ++draws;
+
+            // Samples say nothing of the edges they missed, so an edge over the threshold is set aside like an unsafe one
+            // rather than ending the run. Either comes back once a neighbor collapses.
+            const bool overThreshold = bestError > progress.maxError;
+            if (overThreshold || !checkSafety(*best)) {
+                candidates.remove(best);
+                best->unsafe = true;
+                progress.passedOver |= overThreshold;
+                continue;
+            }
+
+            candidates.remove(best);
+            if (m_recording)
+                m_history.push_back(recordSplit(*best));
+            const Collapse collapse = collapseEdge(*best);
+            updatePlanes(collapse.remaining);
+            m_removedFaces += collapse.removedFaces;
+            progress.result.lastError = bestError;
+
+            for (QEFEdge<QEF> *edge : collapse.condemned)
+                if (edge->invalid() && candidates.contains(edge))
+                    candidates.remove(edge);
+
+            for (uint32_t it : outgoing(collapse.remaining)) {
+                if (QEFEdge<QEF> *edge = &m_edges[m_halfedges[it].e]; edge->unsafe) {
+                    edge->unsafe = false;
+                    candidates.push(edge);
+                }
+            }
+        }
+
+        co_yield progress.reached(finalCount, faceCount(), stats());
+        if (progress.result.reason != StopReason::FaceCount)
+            co_return;
+    }
+}
+
+// Sweeps the edge arena collapsing every safe edge with both ends in one grid cell. The cell a vertex starts in stays its own
+// as it absorbs others, so an edge is in a cell or not for good and a sweep only needs repeating for the ones left unsafe.
+template <class QEF>
+void BasicCollapsible<QEF>::clusterCells(uint64_t goal, Progress& progress) {
+    if (faceCount() <= goal)
+        return;
+
+    // A cell of side h covers about h*h/1.5 of a surface at a random angle, and leaves one vertex and two faces behind.
+    // Sweeps leave around a tenth fewer faces than that, so cells are sized to land just above goal, as stopping short
+    // partway through the arena would leave its far end unclustered.
+    double area = 0.0;
+    for (const Face &face : m_faces) {
+        if (!face.invalid()) {
+            const f32v3 &apex = m_vertices[m_halfedges[face.he].v].pos;
+            for (const Halfedge *he = &m_halfedges[m_halfedges[face.he].next]; he->next != face.he; he = &m_halfedges[he->next])
+                area += 0.5 * (m_vertices[he->v].pos - apex).cross(m_vertices[m_halfedges[he->next].v].pos - apex).length();
+        }
+    }
+    const float cell = static_cast<float>(sqrt(2.5 * area / static_cast<double>(goal)));
+
+    // Cell coordinates packed 21 bits apiece
+    const f32v3 origin = getAABBCentroid() - getAABBSizes() * 0.5f;
+    vector<uint64_t> cells(m_vertices.size());
+    parallelFor(m_vertices.size(), [&](size_t i) {
+        const f32v3 p = (m_vertices[i].pos - origin) / cell;
+        cells[i] = static_cast<uint64_t>(max(0.0f, p.x)) << 42u | static_cast<uint64_t>(max(0.0f, p.y)) << 21u | static_cast<uint64_t>(max(0.0f, p.z));
+    });
+
+    bool merged = false;
+    for (bool sweeping = true; sweeping;) {
+        sweeping = false;
+        for (QEFEdge<QEF> &e : m_edges) {
+            if (faceCount() <= goal || progress.halt())
+                break;
+            if (e.invalid() || locked(e) || cells[m_halfedges[e.he].v] != cells[head(e.he)])
+                continue;
+
+            // Edge errors are only kept fresh for queued edges, so bring this one up to date before judging it
+            updateQEF(e);
+            if (e.error() > progress.maxError || !checkSafety(e))
+                continue;
+
+            if (m_recording)
+                m_history.push_back(recordSplit(e));
+            progress.result.lastError = e.error();
+            const uint32_t remaining = m_halfedges[e.he].v;
+            m_removedFaces += collapse(e);
+            updatePlanes(remaining);
+            sweeping = merged = true;
+        }
+    }
+
+    // The queues trust every live edge's error, and merges left many of them stale
+    if (merged)
+        parallelBlocks(m_edges.size(), [&](size_t begin, size_t end) {
+            updateEdges(begin, end, [](const QEFEdge<QEF>& e) { return !e.invalid(); });
+        });
+}
+
+// The heart of the algorithm. Takes faces down to finalCount and returns how many went, leaving the
+// mesh's own count alone so that tiles can each keep theirs.
+template <class QEF>
+uint64_t BasicCollapsible<QEF>::collapseInOrder(EdgeHeap<QEF>& errors, uint64_t faces, uint64_t finalCount, Progress& progress, vector<VertexSplit<QEF>>& history) {
+    const uint64_t initialFaces = faces;
+    while (faces > finalCount && !errors.empty() && !progress.halt(errors.topKey())) {
+        const float error = errors.topKey();
+        QEFEdge<QEF> *top = errors.pop();
+
+        if (!checkSafety(*top)) {
             // Unsafe edge, remove it, but we'll add it back if a neighbor collapses
             top->unsafe = true;
         } else { // Collapse it!
-            auto remainingVertex = top->he->v;
-            m_removedCount += top->collapse();
+            if (m_recording)
+                history.push_back(recordSplit(*top));
+            const Collapse collapse = collapseEdge(*top);
+            updatePlanes(collapse.remaining);
+            faces -= collapse.removedFaces;
+            progress.result.lastError = error;
+            requeue(errors, collapse);
+        }
+    }
+    return initialFaces - faces;
+}
 
-            remainingVertex->traverseEdges([&](Halfedge* he) {
-                auto edge = static_cast<QEFEdge*>(he->e);
-                edge->dirty = true;
-                if (edge->unsafe) {
-                    edge->unsafe = false;
-                    errors.push({ edge });
-                }
+// Each round takes the cheapest edges off the queue and keeps those whose surrounding faces share no vertex with a
+// cheaper one's. Those collapses cannot see each other, so they run in parallel and give the same mesh at any thread count.
+template <class QEF>
+void BasicCollapsible<QEF>::collapseInBatches(EdgeHeap<QEF>& errors, uint64_t finalCount, const SimplifyOptions& options, Progress& progress) {
+    const unsigned threads = options.threads ? options.threads : hardwareThreads();
+
+    // Each vertex holds the best claim on it, the round in the high half (inverted so newer rounds win) and the rank below
+    vector<atomic<uint64_t>> claims(m_vertices.size());
+    for (auto &claim : claims)
+        claim.store(~0ull, memory_order_relaxed);
+
+    // A collapse rewires every face around both of its ends, so it needs all of their vertices to itself
+    auto region = [&](const QEFEdge<QEF>* edge, auto op) {
+        for (uint32_t end : { m_halfedges[edge->he].v, head(edge->he) })
+            for (uint32_t out : outgoing(end))
+                for (uint32_t corner : perimeter(m_halfedges[out].f))
+                    if (!op(m_halfedges[corner].v))
+                        return false;
+        return true;
+    };
+
+    vector<QEFEdge<QEF>*> batch;
+    vector<float> costs;
+    vector<Collapse> collapses(options.batchSize);
+    vector<VertexSplit<QEF>> splits(m_recording ? options.batchSize : 0ul);
+    batch.reserve(options.batchSize);
+    costs.reserve(options.batchSize);
+
+    for (uint32_t round = 1u; faceCount() > finalCount && !errors.empty() && !progress.halt(errors.topKey()); ++round) {
+        // Stop short once the batch could reach the target. Small meshes get small batches, as most of a large one would
+        // only lose its region and go back in the queue.
+        const size_t batchSize = min<size_t>(options.batchSize, max<size_t>(1ul, faceCount() / 256ul));
+        for (uint64_t removable = 0ul; batch.size() < batchSize && !errors.empty() && faceCount() > finalCount + removable
+                                       && errors.topKey() <= progress.maxError;) {
+            costs.push_back(errors.topKey());
+            batch.push_back(errors.pop());
+            const Halfedge &he = m_halfedges[batch.back()->he];
+            removable += isTriangle(he.f) + isTriangle(m_halfedges[he.flip].f);
+        }
+
+        const unsigned workers = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1ul, batch.size() / 64ul)));
+        auto key = [&](size_t rank) { return uint64_t(~round) << 32u | rank; };
+
+        parallelFor(batch.size(), [&](size_t i) {
+            region(batch[i], [&](uint32_t v) {
+                atomic<uint64_t> &claim = claims[v];
+                for (uint64_t held = claim.load(memory_order_relaxed); key(i) < held && !claim.compare_exchange_weak(held, key(i), memory_order_relaxed););
+                return true;
             });
+        }, workers);
+
+        // Only edges that won their whole region go ahead, the rest wait in the queue where this round's collapses can update them
+        vector<char> won(batch.size());
+        parallelFor(batch.size(), [&](size_t i) {
+            won[i] = region(batch[i], [&](uint32_t v) { return claims[v].load(memory_order_relaxed) == key(i); });
+        }, workers);
+
+        for (size_t i = 0ul; i < batch.size(); ++i)
+            if (!won[i])
+                errors.push(batch[i], batch[i]->error());
+
+        parallelFor(batch.size(), [&](size_t i) {
+            if (!won[i]) {
+                collapses[i].remaining = noHandle;
+            } else if (checkSafety(*batch[i])) {
+                if (m_recording)
+                    splits[i] = recordSplit(*batch[i]);
+                collapses[i] = collapseEdge(*batch[i]);
+                updatePlanes(collapses[i].remaining);
+            } else {
+                // Unsafe edge, it comes back if a neighbor collapses
+                batch[i]->unsafe = true;
+                collapses[i].remaining = noHandle;
+            }
+        }, workers);
+
+        for (size_t i = 0ul; i < batch.size(); ++i) {
+            if (collapses[i].remaining != noHandle) {
+                m_removedFaces += collapses[i].removedFaces;
+                progress.result.lastError = costs[i];
+                requeue(errors, collapses[i]);
+                if (m_recording)
+                    m_history.push_back(splits[i]);
+            }
+        }
+        batch.clear();
+        costs.clear();
+    }
+}
+
+
+/////////////
+// History //
+/////////////
+template <class QEF>
+VertexSplit<QEF> BasicCollapsible<QEF>::recordSplit(const QEFEdge<QEF>& edge) const {
+    const Halfedge &he = m_halfedges[edge.he];
+    const QEFVertex<QEF> &vertex = m_vertices[he.v];
+
+    VertexSplit<QEF> split;
+    split.halfedge = edge.he;
+    split.flip = he.flip;
+    split.edge = handle(&edge);
+    split.vertex = he.v;
+    split.removed = head(edge.he);
+    split.vertexHalfedge = vertex.he;
+    split.removedHalfedge = m_vertices[split.removed].he;
+    split.oldPos = vertex.pos;
+    split.newPos = edge.newPos;
+    split.oldQEF = vertex.qef;
+    split.newQEF = edge.qef;
+    split.oldAttributes = vertex.attributes;
+
+    for (int i = 0; i < 2; ++i) {
+        const Halfedge &h = m_halfedges[i ? he.flip : edge.he], &next = m_halfedges[h.next], &prev = m_halfedges[h.prev];
+        auto &side = split.sides[i];
+        side = {};
+        side.next = h.next;
+        side.prev = h.prev;
+        side.face = h.f;
+        side.faceHalfedge = m_faces[h.f].he;
+        side.triangle = isTriangle(h.f);
+        if (side.triangle) {
+            side.nextFlip = next.flip;
+            side.prevFlip = prev.flip;
+            side.nextEdge = next.e;
+            side.prevEdge = prev.e;
+            side.nextEdgeHalfedge = m_edges[next.e].he;
+            side.prevEdgeHalfedge = m_edges[prev.e].he;
+            side.apexHalfedge = m_vertices[prev.v].he;
+        }
+    }
+
+    return split;
+}
+
+// Puts back every link the collapse changed, so the mesh is exactly as it was before it
+template <class QEF>
+void BasicCollapsible<QEF>::undoCollapse(const VertexSplit<QEF>& split) {
+    QEFVertex<QEF> &vertex = m_vertices[split.vertex], &removed = m_vertices[split.removed];
+
+    for (int i = 0; i < 2; ++i) {
+        const auto &side = split.sides[i];
+        const uint32_t self = i ? split.flip : split.halfedge;
+        Halfedge &h = m_halfedges[self], &next = m_halfedges[side.next], &prev = m_halfedges[side.prev];
+
+        h = { side.next, side.prev, i ? split.halfedge : split.flip, i ? split.removed : split.vertex, split.edge, side.face };
+        m_faces[side.face].he = side.faceHalfedge;
+
+        if (side.triangle) {
+            Halfedge &nextFlip = m_halfedges[side.nextFlip], &prevFlip = m_halfedges[side.prevFlip];
+            const uint32_t apex = nextFlip.v;
+
+            next = { side.prev, self, side.nextFlip, i ? split.vertex : split.removed, side.nextEdge, side.face };
+            prev = { self, side.next, side.prevFlip, apex, side.prevEdge, side.face };
+            nextFlip.flip = side.next;
+            nextFlip.e = side.nextEdge;
+            prevFlip.flip = side.prev;
+            m_edges[side.nextEdge].he = side.nextEdgeHalfedge;
+            m_edges[side.prevEdge].he = side.prevEdgeHalfedge;
+            m_vertices[apex].he = side.apexHalfedge;
+        } else {
+            prev.next = self;
+            next.prev = self;
         }
     }
 
+    m_edges[split.edge].he = split.halfedge;
+    vertex.he = split.vertexHalfedge;
+    vertex.pos = split.oldPos;
+    vertex.qef = split.oldQEF;
+    vertex.attributes = split.oldAttributes;
+
+    // With the links back in place the removed vertex's ring can be walked to reclaim it
+    removed.he = split.removedHalfedge;
+    for (uint32_t it : outgoing(split.removed))
+        m_halfedges[it].v = split.removed;
+
+    m_removedFaces -= split.removedFaces();
+    refreshAround(split.vertex);
+    refreshAround(split.removed);
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::redoCollapse(const VertexSplit<QEF>& split) {
+    QEFEdge<QEF> &edge = m_edges[split.edge];
+    edge.qef = split.newQEF;
+    edge.newPos = split.newPos;
+
+    m_removedFaces += collapse(edge);
+    refreshAround(split.vertex);
+}
+
+// Edge errors and face planes around a vertex that moved, as simplify expects them
+template <class QEF>
+void BasicCollapsible<QEF>::refreshAround(uint32_t v) {
+    for (uint32_t he : outgoing(v))
+        updateQEF(m_edges[m_halfedges[he].e]);
+    updatePlanes(v);
+}
+
+template <class QEF>
+void BasicCollapsible<QEF>::setFaceCount(uint64_t faces) {
+    while (m_applied > 0ul && faceCount() + m_history[m_applied - 1ul].removedFaces() <= faces)
+        undoCollapse(m_history[--m_applied]);
+    while (m_applied < m_history.size() && faceCount() > faces)
+        redoCollapse(m_history[m_applied++]);
+
 #ifndef NDEBUG
     verifyConnections();
 #endif
+}
 
-    m_vertices.remove_if([](auto& v){ return v.invalid(); });
-    m_faces.remove_if([](auto& f){ return f.invalid(); });
-    m_edges.remove_if([](auto& e){ return e.invalid(); });
-    m_halfedges.remove_if([](auto& he){ return he.invalid(); });
+template <class QEF>
+size_t BasicCollapsible<QEF>::compact() {
+    m_history.clear();
+    m_applied = 0ul;
+    const size_t removed = Base::compact();
+
+    // Compaction renumbered the faces the planes are kept by
+    buildPlanes();
+    return removed;
 }
+
+template <class QEF>
+void BasicCollapsible<QEF>::writeProgressive(const char* file) {
+    ofstream out(file, ios::binary);
+    if (!out.is_open())
+        throw string("Could not open file ") + file + " for writing";
+
+    // Start from the coarsest level, numbered the way exportMesh numbers it
+    const size_t level = m_applied;
+    setFaceCount(0ul);
+
+    const MeshData base = exportMesh();
+    ProgressiveHeader header = {};
+    memcpy(header.magic, ProgressiveHeader::expectedMagic, sizeof(header.magic));
+    header.version = ProgressiveHeader::currentVersion;
+    header.baseVertexCount = static_cast<uint32_t>(base.positions.size());
+    header.baseFaceCount = static_cast<uint32_t>(base.faceCount());
+    header.baseCornerCount = static_cast<uint32_t>(base.indices.size());
+    header.splitCount = static_cast<uint32_t>(m_applied);
+
+    vector<uint32_t> degrees(base.faceCount());
+    for (size_t face = 0ul; face < degrees.size(); ++face)
+        degrees[face] = base.faceStarts[face + 1ul] - base.faceStarts[face];
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(base.positions.data()), base.positions.size() * sizeof(f32v3));
+    out.write(reinterpret_cast<const char*>(degrees.data()), degrees.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(base.indices.data()), base.indices.size() * sizeof(uint32_t));
+
+    vector<uint32_t> vertexIds(m_vertices.size(), ~0u), faceIds(m_faces.size(), ~0u);
+    uint32_t vertexCount = 0u, faceCount = 0u;
+    for (size_t i = 0ul; i < m_vertices.size(); ++i)
+        if (!m_vertices[i].invalid())
+            vertexIds[i] = vertexCount++;
+    for (size_t i = 0ul; i < m_faces.size(); ++i)
+        if (!m_faces[i].invalid())
+            faceIds[i] = faceCount++;
+
+    // Undo back to the finest level, describing what each split does to the faces as a soup
+    vector<uint32_t> edits;
+    while (m_applied > 0ul) {
+        const VertexSplit<QEF> &split = m_history[--m_applied];
+        undoCollapse(split);
+
+        ProgressiveSplit record = {};
+        record.vertex = vertexIds[split.vertex];
+        record.vertexPos = m_vertices[split.vertex].pos;
+        record.newPos = m_vertices[split.removed].pos;
+        vertexIds[split.removed] = vertexCount++;
+
+        edits.clear();
+        for (int i = 0; i < 2; ++i) {
+            const auto &side = split.sides[i];
+            if (side.triangle) {
+                faceIds[side.face] = faceCount++;
+                record.apexes[i] = vertexIds[m_halfedges[side.prev].v];
+                record.triangles |= uint8_t(1u << i);
+            } else {
+                edits.push_back(faceIds[side.face] | (i ? ProgressiveSplit::InsertBefore : ProgressiveSplit::InsertAfter));
+            }
+        }
+
+        // Every other face around the removed vertex held the merged one in its place
+        for (uint32_t he : outgoing(split.removed))
+            if (const uint32_t f = m_halfedges[he].f; f != split.sides[0].face && f != split.sides[1].face)
+                edits.push_back(faceIds[f] | ProgressiveSplit::Replace);
+
+        record.editCount = static_cast<uint16_t>(edits.size());
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        out.write(reinterpret_cast<const char*>(edits.data()), edits.size() * sizeof(uint32_t));
+    }
+
+    while (m_applied < level)
+        redoCollapse(m_history[m_applied++]);
+
+    if (!out)
+        throw string("Could not write ") + file;
+}
+
+
+//////////////////////////////////////
+// TEMPLATE DECLARATIONS FOR SANITY //
+//////////////////////////////////////
+template struct QEFEdge<DistanceQEF>;
+template struct QEFEdge<PlaneQEF>;
+template class BasicCollapsible<DistanceQEF>;
+template class BasicCollapsible<PlaneQEF>;
+template struct AttributeQEF<2>;
+template struct AttributeQEF<3>;
+template struct QEFEdge<AttributeQEF<2>>;
+template struct QEFEdge<AttributeQEF<3>>;
+template class BasicCollapsible<AttributeQEF<2>>;
+template class BasicCollapsible<AttributeQEF<3>>;
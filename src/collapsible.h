@@ -2,14 +2,232 @@
 
 #include "manifold.h"
 #include "errorfunction.h"
+#include "generator.h"
+#include "indexedheap.h"
 
+#include <chrono>  // steady_clock
+#include <limits>  // numeric_limits
+#include <utility> // forward
+
+
+template <class QEF> using EdgeHeap = IndexedHeap<QEFEdge<QEF>, &QEFEdge<QEF>::queueSlot>;
+template <class QEF> using EdgePool = IndexedPool<QEFEdge<QEF>, &QEFEdge<QEF>::queueSlot>;
+
+enum class SimplifyEngine {
+    Heap,          // Greedy, always the cheapest edge in the mesh
+    MultipleChoice, // The cheapest of a few random edges, no global ordering to maintain
+    Tiled           // Slabs of the mesh simplified side by side with their seams frozen, then the seams on their own
+};
+
+struct SimplifyOptions {
+    SimplifyEngine engine = SimplifyEngine::Heap;
+
+    // Edges collapsed together per round. 1 is strictly cheapest first, larger batches give up
+    // a little of that ordering so the collapses in a round can run in parallel.
+    size_t batchSize = 1ul;
+
+    // Threads sharing each round, or tiles for the tiled engine, 0 for all of them
+    unsigned threads = 0u;
+
+    // Edges drawn per step by the multiple choice engine, and the seed they are drawn with
+    unsigned samples = 8u;
+    uint64_t seed = 0ul;
+
+    // Keep every collapse so it can be undone and redone later, see Collapsible::setFaceCount
+    bool record = false;
+
+    // Before the cheapest-first collapses, merge the ends of any edge that fall in the same cell of a uniform grid, with
+    // cells sized to leave about clusterRatio times the final face count. 0 skips it. A merge there costs a fraction of a
+    // queued one, which pays off when the final count is a tiny fraction of the input, at some cost in error.
+    float clusterRatio = 0.0f;
+
+    // Stop short of the face count rather than collapse an edge costing more than maxError, or once timeBudget has
+    // passed since the call. The clock is only read every few dozen collapses, so the budget can overrun by that much.
+    float maxError = std::numeric_limits<float>::infinity();
+    std::chrono::steady_clock::duration timeBudget = std::chrono::steady_clock::duration::max();
+};
+
+enum class StopReason {
+    FaceCount,  // Reached the face count
+    MaxError,   // Every edge left costs more than the error threshold
+    TimeBudget, // Ran out of time
+    Exhausted   // No safe collapse left
+};
+
+struct SimplifyResult {
+    StopReason reason = StopReason::FaceCount;
+    float lastError = 0.0f; // Cost of the last collapse made, 0 if there was none
+    QueueStats queue;
+};
+
+// Everything needed to undo one collapse in place, as arena handles. The collapse ran along halfedge, from vertex
+// to removed, and merged removed into vertex. Dead elements keep their arena slots, so undoing just rewires them.
+template <class QEF>
+struct VertexSplit {
+    // The face on one side of halfedge, along it and then along its flip
+    struct Side {
+        uint32_t next, prev, face, faceHalfedge;
+        bool triangle;
+
+        // The collapse deletes a triangle side outright and patches the two edges left over
+        uint32_t nextFlip, prevFlip, nextEdge, prevEdge, nextEdgeHalfedge, prevEdgeHalfedge, apexHalfedge;
+    };
+
+    uint32_t halfedge, flip, edge, vertex, removed, vertexHalfedge, removedHalfedge;
+    Side sides[2];
+    f32v3 oldPos, newPos;
+    QEF oldQEF, newQEF;
+    [[no_unique_address]] typename QEF::Attributes oldAttributes;
+
+    uint64_t removedFaces() const { return sides[0].triangle + sides[1].triangle; }
+};
+
+
+template <class QEF>
+class BasicCollapsible : public Manifold<QEFVertex<QEF>, QEFEdge<QEF>> {
+    using Base = Manifold<QEFVertex<QEF>, QEFEdge<QEF>>;
 
-class Collapsible : public Manifold<QEFVertex, QEFEdge> {
 public:
-    Collapsible(const char* objfile);
+    BasicCollapsible(const char* meshfile, LoadMode mode = LoadMode::Parallel, bool useCache = true);
+    BasicCollapsible(const MeshData& mesh);
+
+    // The base depends on QEF, so its members have to be named before they can be used unqualified
+    using Base::faceCount;
+    using Base::getAABBSizes;
+    using Base::getAABBCentroid;
+    using Base::nextAround;
+    using Base::head;
+    using Base::outgoing;
+    using Base::perimeter;
+    using Base::centroid;
+    using Base::isTriangle;
 
-    void simplify(uint64_t finalCount);
+    // Locked vertices are never moved or removed, flags are in vertex arena order
+    void lockVertices(const std::vector<bool>& locked);
+    std::vector<bool> lockedVertices() const;
+
+    // Live vertices and faces as a polygon soup, with the normals or texture coordinates the metric carried if it did
+    MeshData exportMesh() const;
+
+    // Collapses the cheapest safe edges until at most finalCount faces remain, nothing more can go, or the error or time
+    // limits in options are hit. Recording drops any collapses undone before it, the same way an editor forgets its redo steps.
+    SimplifyResult simplify(uint64_t finalCount, const SimplifyOptions& options = {});
+
+    // A whole LOD chain in one continuous simplification, snapshotting the live mesh as it reaches each target.
+    // Snapshots come back in the same order as the targets.
+    std::vector<MeshData> simplify(const std::vector<uint64_t>& targets, const SimplifyOptions& options = {});
+
+    // The same simplification a stride of faces at a time, each step yielded with the reason it ended. Between steps the
+    // mesh is whole and can be read, waiting pauses the run, and dropping the generator stops it keeping what was done.
+    Generator<SimplifyResult> simplifySteps(uint64_t finalCount, uint64_t stride, const SimplifyOptions& options = {});
+
+    // Undoes or redoes recorded collapses to reach the finest level with at most faces faces,
+    // in time proportional to the collapses it passes
+    void setFaceCount(uint64_t faces);
+    size_t recordedCollapses() const { return m_history.size(); }
+    size_t appliedCollapses() const { return m_applied; }
+
+    // Writes the coarsest recorded level and the splits that refine it back to the finest, see progressive.h
+    void writeProgressive(const char* file);
+
+    // Compaction renumbers every element, so the history is forgotten
+    size_t compact();
+
+protected:
+    using Base::m_vertices;
+    using Base::m_edges;
+    using Base::m_faces;
+    using Base::m_halfedges;
+    using Base::m_removedFaces;
+    using Base::handle;
+    using Base::build;
+    using Base::buildFromCache;
+    using Base::startCache;
+#ifndef NDEBUG
+    using Base::verifyConnections;
+#endif
+
+    // An edge's ends and faces are only reachable through the arenas, so it is worked on here. sumQEF adds up the QEFs
+    // of the two ends, leaving newPos and cost to be solved for, and updateQEF does both.
+    void sumQEF(QEFEdge<QEF>& edge) const;
+    void updateQEF(QEFEdge<QEF>& edge) const;
+    bool locked(const QEFEdge<QEF>& edge) const;
+    bool checkSafety(const QEFEdge<QEF>& edge) const;
+    uint64_t collapse(QEFEdge<QEF>& edge);
 
 private:
-    size_t m_removedCount;
+    // Limits and outcome of one simplify call, shared by every target it passes
+    struct Progress;
+
+    // Everything a collapse leaves behind for the queue to tidy up
+    struct Collapse;
+
+    Collapse collapseEdge(QEFEdge<QEF>& edge);
+    void requeue(EdgeHeap<QEF>& errors, const Collapse& collapse);
+    std::vector<QEFEdge<QEF>*> queueable();
+
+    VertexSplit<QEF> recordSplit(const QEFEdge<QEF>& edge) const;
+    void undoCollapse(const VertexSplit<QEF>& split);
+    void redoCollapse(const VertexSplit<QEF>& split);
+    void refreshAround(uint32_t v);
+
+    // The plane metric builds vertex QEFs out of m_planes, the plane of every face by handle, worked out once for the
+    // whole mesh. Each collapse or undo then redoes only the planes of the faces around the vertex it moved.
+    void buildPlanes();
+    void buildVertexQEFs();
+    void updatePlanes(uint32_t v);
+
+    // An attribute metric takes its normals or texture coordinates from the mesh, which has to have them
+    void loadAttributes(const MeshData& mesh);
+
+    // Brings the QEF and minimizer of every edge in [begin, end) of the arena that keep accepts up to date, solving
+    // them a batch at a time with the widest kernel the CPU has
+    template <class Keep>
+    void updateEdges(size_t begin, size_t end, Keep keep);
+
+    // Simplifies down through targets, largest first, yielding as each is reached. Coroutines outlive the
+    // arguments they were called with, so they take their own copies.
+    Generator<SimplifyResult> stepThrough(std::vector<uint64_t> targets, SimplifyOptions options);
+    Generator<SimplifyResult> collapseQueued(std::vector<uint64_t> targets, SimplifyOptions options, Progress& progress);
+    Generator<SimplifyResult> collapseSampled(std::vector<uint64_t> targets, SimplifyOptions options, Progress& progress);
+    Generator<SimplifyResult> collapseTiled(std::vector<uint64_t> targets, SimplifyOptions options, Progress& progress);
+
+    void clusterCells(uint64_t goal, Progress& progress);
+    uint64_t collapseInOrder(EdgeHeap<QEF>& errors, uint64_t faces, uint64_t finalCount, Progress& progress, std::vector<VertexSplit<QEF>>& history);
+    QueueStats collapseInTiles(uint64_t finalCount, unsigned tiles, Progress& progress);
+    void collapseInBatches(EdgeHeap<QEF>& errors, uint64_t finalCount, const SimplifyOptions& options, Progress& progress);
+
+    // Recorded collapses, the first m_applied of which are in effect
+    std::vector<VertexSplit<QEF>> m_history;
+    size_t m_applied = 0ul;
+    bool m_recording = false;
+
+    // Empty for any other metric
+    std::vector<FacePlane> m_planes;
+
+    // Attributes are kept multiplied by this, see AttributeQEF::attributeScale
+    float m_attributeScale = 1.0f;
 };
+
+using Collapsible = BasicCollapsible<DistanceQEF>;
+
+// Builds the mesh from args with the given metric and hands it to op, so the metric can be picked at runtime while
+// everything op does is compiled for it. op has to give back the same type for every metric.
+template <class Op, class... Args>
+auto withMetric(ErrorMetric metric, Op&& op, Args&&... args) {
+    if (metric == ErrorMetric::Plane) {
+        BasicCollapsible<PlaneQEF> mesh(std::forward<Args>(args)...);
+        return op(mesh);
+    }
+    if (metric == ErrorMetric::Normal) {
+        BasicCollapsible<NormalQEF> mesh(std::forward<Args>(args)...);
+        return op(mesh);
+    }
+    if (metric == ErrorMetric::Texture) {
+        BasicCollapsible<TextureQEF> mesh(std::forward<Args>(args)...);
+        return op(mesh);
+    }
+
+    BasicCollapsible<DistanceQEF> mesh(std::forward<Args>(args)...);
+    return op(mesh);
+}
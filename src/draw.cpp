@@ -0,0 +1,105 @@
+#include "errorfunction.h"
+#include "manifold.h"
+
+#include <GL/gl.h> // glBegin, glEnd, glColor4fv, glMaterialfv, glNormal3fv, glVertex3fv, GL_*
+#include <vector>  // vector
+
+using namespace std;
+
+
+// Everything that touches OpenGL, linked into the viewer alone so the rest of the simplifier builds without it
+
+//////////////
+// Halfedge //
+//////////////
+void Vertex::draw() const {
+    glVertex3fv(&pos.x);
+}
+
+
+//////////////
+// Manifold //
+//////////////
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::drawFace(uint32_t f) const {
+    const f32v3 n = normal(f);
+    glNormal3fv(&n.x);
+
+    for (uint32_t he : perimeter(f))
+        m_vertices[m_halfedges[he].v].draw();
+}
+
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::drawFaces() const {
+    vector<uint32_t> nonTris;
+
+    // Should be faster
+    static const GLfloat white[] = { 1.0f, 1.0f, 1.0f };
+    glEnable(GL_LIGHTING);
+    glMaterialfv(GL_FRONT, GL_AMBIENT, white);
+    glBegin(GL_TRIANGLES); {
+        for (uint32_t f = 0u; f < m_faces.size(); ++f)
+            if (m_faces[f].invalid())
+                continue;
+            else if (m_trianglesOnly || isTriangle(f))
+                drawFace(f);
+            else
+                nonTris.push_back(f);
+    } glEnd();
+
+    // Slower but draws degree 4+ polys correctly
+    static const GLfloat blue[] = { 0.6f, 0.6f, 1.0f };
+    glMaterialfv(GL_FRONT, GL_AMBIENT, blue);
+    for (uint32_t f : nonTris) {
+        glBegin(GL_POLYGON); {
+            drawFace(f);
+        } glEnd();
+    }
+}
+
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::drawEdges() const {
+    static const GLfloat yellow[] = { 1.0f, 1.0f, 0.0f, 1.0f };
+    glDisable(GL_LIGHTING);
+    glColor4fv(yellow);
+    glBegin(GL_LINES); {
+        for (const Edge &edge : m_edges) {
+            if (!edge.invalid()) {
+                m_vertices[m_halfedges[edge.he].v].draw();
+                m_vertices[head(edge.he)].draw();
+            }
+        }
+    } glEnd();
+}
+
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::drawVertices() const {
+    static const GLfloat red[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+    glDisable(GL_LIGHTING);
+    glColor4fv(red);
+    glBegin(GL_POINTS); {
+        for (const Vertex &vertex : m_vertices)
+            if (!vertex.invalid())
+                vertex.draw();
+    } glEnd();
+}
+
+
+//////////////////////////////////////
+// TEMPLATE DECLARATIONS FOR SANITY //
+//////////////////////////////////////
+template void Manifold<Vertex, Edge>::drawFaces() const;
+template void Manifold<Vertex, Edge>::drawEdges() const;
+template void Manifold<Vertex, Edge>::drawVertices() const;
+template void Manifold<QEFVertex<DistanceQEF>, QEFEdge<DistanceQEF>>::drawFaces() const;
+template void Manifold<QEFVertex<DistanceQEF>, QEFEdge<DistanceQEF>>::drawEdges() const;
+template void Manifold<QEFVertex<DistanceQEF>, QEFEdge<DistanceQEF>>::drawVertices() const;
+template void Manifold<QEFVertex<PlaneQEF>, QEFEdge<PlaneQEF>>::drawFaces() const;
+template void Manifold<QEFVertex<PlaneQEF>, QEFEdge<PlaneQEF>>::drawEdges() const;
+template void Manifold<QEFVertex<PlaneQEF>, QEFEdge<PlaneQEF>>::drawVertices() const;
+template void Manifold<QEFVertex<AttributeQEF<2>>, QEFEdge<AttributeQEF<2>>>::drawFaces() const;
+template void Manifold<QEFVertex<AttributeQEF<2>>, QEFEdge<AttributeQEF<2>>>::drawEdges() const;
+template void Manifold<QEFVertex<AttributeQEF<2>>, QEFEdge<AttributeQEF<2>>>::drawVertices() const;
+template void Manifold<QEFVertex<AttributeQEF<3>>, QEFEdge<AttributeQEF<3>>>::drawFaces() const;
+template void Manifold<QEFVertex<AttributeQEF<3>>, QEFEdge<AttributeQEF<3>>>::drawEdges() const;
+template void Manifold<QEFVertex<AttributeQEF<3>>, QEFEdge<AttributeQEF<3>>>::drawVertices() const;
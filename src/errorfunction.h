@@ -2,15 +2,38 @@
 
 #include "halfedge.h"
 
+#include <array>       // array
+#include <cstddef>     // size_t
+#include <cstdint>     // uint32_t
+#include <type_traits> // is_same_v
+
+
+enum class ErrorMetric {
+    Distance, // Squared distance to the neighboring vertices, cheap and smooth but rounds off sharp features
+    Plane,    // Squared distance to the planes of the neighboring faces, keeps creases and corners where they are
+    Normal,   // Plane, with the vertex normals carried through and kept from straying too, the mesh needs normals
+    Texture   // Plane, with the texture coordinates carried through likewise, the mesh needs texture coordinates
+};
+
+struct NoAttributes {};
 
 template <class Derived>
 struct QuadraticErrorFunction {
+    // Values a vertex carries besides its position, and the ones that go best with a given position. Derived replaces
+    // both if it has any.
+    using Attributes = NoAttributes;
+    NoAttributes attributesAtImpl(const f32v3&) const { return {}; }
+
     inline float evaluateError(const f32v3& p) const { return static_cast<const Derived*>(this)->evaluateErrorImpl(p); }
     inline f32v3 minimizeError() const { return static_cast<const Derived*>(this)->minimizeErrorImpl(); }
+    inline auto attributesAt(const f32v3& p) const { return static_cast<const Derived*>(this)->attributesAtImpl(p); }
 
     inline QuadraticErrorFunction operator+(const Derived& qef) const { return *static_cast<const Derived*>(this) + qef; }
 };
 
+template <class QEF>
+inline constexpr bool carriesAttributes = !std::is_same_v<typename QEF::Attributes, NoAttributes>;
+
 struct DistanceQEF : public QuadraticErrorFunction<DistanceQEF> {
     float n;
     f32v3 Sv;
@@ -18,7 +41,17 @@ struct DistanceQEF : public QuadraticErrorFunction<DistanceQEF> {
 
     DistanceQEF() = default;
     DistanceQEF(float n, const f32v3& Sv, float Svtv);
-    DistanceQEF(Halfedge* he);
+
+    // Over the neighbors of vertex v of mesh
+    template <class Mesh>
+    DistanceQEF(const Mesh& mesh, uint32_t v) : DistanceQEF() {
+        for (uint32_t it : mesh.outgoing(v)) {
+            const f32v3 &neighbor = mesh.vertex(mesh.head(it)).pos;
+            ++n;
+            Sv += neighbor;
+            Svtv += neighbor.dot(neighbor);
+        }
+    }
 
     float evaluateErrorImpl(const f32v3& p) const;
     f32v3 minimizeErrorImpl() const;
@@ -26,42 +59,134 @@ struct DistanceQEF : public QuadraticErrorFunction<DistanceQEF> {
     DistanceQEF operator+(const DistanceQEF& qef) const;
 };
 
+// The plane a face lies on, every x with n . x = d. A degenerate face has no direction to give, and n comes out
+// short of unit length or not a number at all.
+struct FacePlane {
+    f32v3 n;
+    float d;
+
+    FacePlane() = default;
+    FacePlane(const f32v3& n, float d) : n(n), d(d) {}
+
+    // Of face f of mesh
+    template <class Mesh>
+    FacePlane(const Mesh& mesh, uint32_t f) : n(mesh.normal(f)), d(mesh.vertex(mesh.halfedge(mesh.face(f).he).v).pos.dot(n)) {}
+};
+
+// Squared distance to the planes of the faces around, after Garland and Heckbert. Planes meeting at a crease or lying
+// flat leave the minimizer free along a line or a whole plane, which is settled at the neighbors' centroid. On a
+// finely curved surface every plane error is down in the rounding noise, so a trace of the distance to the neighbors
+// is added in to break the ties, or the noise would pile collapse after collapse onto the same few vertices.
 struct PlaneQEF : public QuadraticErrorFunction<PlaneQEF> {
+    static constexpr float tieWeight = 1e-2f;
+
+    // Below this fraction of the matrix's scale an eigenvalue is noise from planes that are nearly parallel, and
+    // solving along it would fling the point far off along the crease or the flat
+    static constexpr float rankTolerance = 1e-3f;
+
     f32v3 Snnt012, Snnt458, Snd;
     float Sd2;
+    DistanceQEF neighbors;
 
     PlaneQEF() = default;
-    PlaneQEF(const f32v3& Snnt012, const f32v3& Snnt458, const f32v3& Snd, float Sd2);
-    PlaneQEF(Vertex* v);
+    PlaneQEF(const f32v3& Snnt012, const f32v3& Snnt458, const f32v3& Snd, float Sd2, const DistanceQEF& neighbors);
+
+    // Over the faces around vertex v of mesh
+    template <class Mesh>
+    PlaneQEF(const Mesh& mesh, uint32_t v) : PlaneQEF(mesh, v, [&](uint32_t f) { return FacePlane(mesh, f); }) {}
+
+    // The same, with the plane of each face around looked up by planeOf(face) rather than worked out again
+    template <class Mesh, class PlaneOf>
+    PlaneQEF(const Mesh& mesh, uint32_t v, PlaneOf planeOf) : PlaneQEF() {
+        neighbors = { mesh, v };
+        for (uint32_t it : mesh.outgoing(v))
+            addPlane(planeOf(mesh.halfedge(it).f));
+    }
 
     float evaluateErrorImpl(const f32v3& p) const;
     f32v3 minimizeErrorImpl() const;
 
     PlaneQEF operator+(const PlaneQEF& qef) const;
 
+    // Adds the squared distance to one more plane
+    void addPlane(const FacePlane& plane);
+
 private:
     f32v3 Snnt345() const { return { Snnt012.y, Snnt458.x, Snnt458.y }; }
     f32v3 Snnt678() const { return { Snnt012.z, Snnt458.y, Snnt458.z }; }
+    f32v3 multiply(const f32v3& p) const { return { p.dot(Snnt012), p.dot(Snnt345()), p.dot(Snnt678()) }; }
+};
+
+// The plane QEF with N attributes carried along, normals or texture coordinates, after Hoppe's quadric for appearance
+// attributes. Each face adds the squared distance to its plane and, for every attribute, the squared difference from
+// that attribute interpolated linearly across the face. The attributes that minimize it follow in closed form from
+// any position, so eliminating them leaves a plane QEF in the position alone, which is solved just as one. Attributes
+// have to come in the same units as positions, see attributeScale.
+template <size_t N>
+struct AttributeQEF : public QuadraticErrorFunction<AttributeQEF<N>> {
+    using Attributes = std::array<float, N>;
+
+    // Attributes go in multiplied by this many of the mesh's bounding box diagonals, so that an attribute straying by
+    // a whole unit costs as much as the surface straying by that far
+    static constexpr float attributeScale = 1e-2f;
+
+    // Everything in the position, plus per attribute the sums of its gradients and offsets over the faces
+    PlaneQEF position;
+    std::array<f32v3, N> Sg;
+    Attributes Se;
+    float faces;
+
+    AttributeQEF() = default;
+    AttributeQEF(const PlaneQEF& position, const std::array<f32v3, N>& Sg, const Attributes& Se, float faces);
+
+    // Over the faces around vertex v of mesh, attributesOf(vertex) giving the attributes at each of their corners
+    template <class Mesh, class AttributesOf>
+    AttributeQEF(const Mesh& mesh, uint32_t v, AttributesOf attributesOf) : AttributeQEF() {
+        position.neighbors = { mesh, v };
+        for (uint32_t it : mesh.outgoing(v)) {
+            const Halfedge &a = mesh.halfedge(mesh.face(mesh.halfedge(it).f).he), &b = mesh.halfedge(a.next), &c = mesh.halfedge(b.next);
+            addFace(mesh.vertex(a.v).pos, mesh.vertex(b.v).pos, mesh.vertex(c.v).pos, attributesOf(a.v), attributesOf(b.v), attributesOf(c.v));
+        }
+    }
+
+    float evaluateErrorImpl(const f32v3& p) const;
+    f32v3 minimizeErrorImpl() const;
+    Attributes attributesAtImpl(const f32v3& p) const;
+
+    AttributeQEF operator+(const AttributeQEF& qef) const;
+
+private:
+    // Faces of more than three corners are taken at their first three
+    void addFace(const f32v3& p0, const f32v3& p1, const f32v3& p2, const Attributes& s0, const Attributes& s1, const Attributes& s2);
+
+    // The plane QEF left once the attributes are chosen for the position
+    PlaneQEF eliminated() const;
 };
 
-using QEFType = DistanceQEF;
+using NormalQEF = AttributeQEF<3>;
+using TextureQEF = AttributeQEF<2>;
 
 
+template <class QEF>
 struct QEFVertex : public Vertex {
-    QEFType qef;
+    QEF qef;
+    [[no_unique_address]] typename QEF::Attributes attributes;
+    bool locked;
 
-    QEFVertex(Halfedge* he, f32v3 pos): Vertex{he, pos}, qef() {}
+    QEFVertex(uint32_t he, f32v3 pos): Vertex{he, pos}, qef(), attributes(), locked(false) {}
 };
 
 
+template <class QEF>
 struct QEFEdge : public Edge {
-    QEFType qef;
+    QEF qef;
     f32v3 newPos;
-    bool dirty, unsafe;
+    float cost; // qef's error at newPos, kept with it so queueing an edge never evaluates it again
+    uint32_t queueSlot;
+    bool unsafe;
 
-    QEFEdge(nullptr_t): Edge{nullptr} {}
+    QEFEdge(uint32_t he): Edge{he}, cost(0.0f), queueSlot(~0u), unsafe(false) {}
 
-    void updateQEF();
-    bool checkSafety() const;
-    size_t collapse();
+    // Anything that follows the edge's links is on BasicCollapsible, which has the arenas they lead into
+    float error() const { return cost; }
 };
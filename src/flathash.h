@@ -0,0 +1,87 @@
+#pragma once
+
+#include "simd.h"
+
+#include <bit>     // bit_cast, bit_ceil, countr_zero
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <utility> // pair
+#include <vector>  // vector
+
+
+// Fibonacci hashing, spreads nearby keys across the whole table
+struct FibonacciHash {
+    size_t operator()(uint64_t key) const { return static_cast<size_t>(key * 0x9E3779B97F4A7C15ull); }
+};
+
+// Positions keyed on their exact bit patterns, for welding coincident vertices
+struct PositionKey {
+    uint32_t x, y, z;
+
+    // Adding zero folds -0 into +0 so they weld together
+    static PositionKey of(const f32v3& p) {
+        return { std::bit_cast<uint32_t>(p.x + 0.0f), std::bit_cast<uint32_t>(p.y + 0.0f), std::bit_cast<uint32_t>(p.z + 0.0f) };
+    }
+
+    bool operator==(const PositionKey&) const = default;
+};
+
+struct PositionHash {
+    size_t operator()(const PositionKey& key) const {
+        return FibonacciHash()((uint64_t(key.x) << 32u | key.y) ^ (uint64_t(key.z) * 0xC2B2AE3D27D4EB4Full));
+    }
+};
+
+// Insert-only open addressing table with linear probing, sized once up front.
+// One key value is reserved to mark empty slots and can never be inserted.
+template <class Key, class Value, class Hash = FibonacciHash>
+class FlatHashMap {
+public:
+    FlatHashMap(size_t expected, const Key& empty)
+      : m_slots(std::bit_ceil(expected * 2ul + 1ul), Slot{ empty, {} })
+      , m_shift(64 - std::countr_zero(m_slots.size()))
+      , m_empty(empty)
+      , m_size(0ul) {
+    }
+
+    // Finds the key, or claims a slot for it holding value. The bool is true if it was claimed.
+    std::pair<Value*, bool> tryEmplace(const Key& key, const Value& value) {
+        const size_t mask = m_slots.size() - 1ul;
+        for (size_t i = home(key);; i = (i + 1ul) & mask) {
+            Slot &slot = m_slots[i];
+            if (slot.key == key)
+                return { &slot.value, false };
+            if (slot.key == m_empty) {
+                slot = { key, value };
+                ++m_size;
+                return { &slot.value, true };
+            }
+        }
+    }
+
+    Value* find(const Key& key) {
+        const size_t mask = m_slots.size() - 1ul;
+        for (size_t i = home(key);; i = (i + 1ul) & mask) {
+            if (m_slots[i].key == key)
+                return &m_slots[i].value;
+            if (m_slots[i].key == m_empty)
+                return nullptr;
+        }
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    struct Slot {
+        Key key;
+        Value value;
+    };
+
+    // The top bits of the hash are the best mixed
+    size_t home(const Key& key) const { return m_shift < 64 ? Hash()(key) >> m_shift : 0ul; }
+
+    std::vector<Slot> m_slots;
+    int m_shift;
+    Key m_empty;
+    size_t m_size;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <coroutine> // coroutine_handle, suspend_always
+#include <cstddef>   // ptrdiff_t
+#include <exception> // exception_ptr, current_exception, rethrow_exception
+#include <iterator>  // default_sentinel, default_sentinel_t
+#include <memory>    // addressof
+#include <utility>   // exchange, swap
+
+
+// Coroutine that hands out a value at every co_yield and runs no further until the next one is asked for. Values are
+// lent, not copied, so each is only good until the iterator moves on. Dropping the generator abandons the coroutine
+// wherever it is suspended, destroying its locals as if it had returned there.
+template <class T>
+class Generator {
+public:
+    struct promise_type {
+        const T *value = nullptr;
+        std::exception_ptr error;
+
+        Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+
+        // The yielded expression lives until the coroutine resumes, so pointing at it is enough
+        std::suspend_always yield_value(const T& yielded) noexcept { value = std::addressof(yielded); return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    class iterator {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        explicit iterator(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+
+        const T& operator*() const { return *m_coroutine.promise().value; }
+
+        iterator& operator++() { resume(m_coroutine); return *this; }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const { return m_coroutine.done(); }
+
+    private:
+        std::coroutine_handle<promise_type> m_coroutine;
+    };
+
+    Generator(Generator&& other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+    Generator& operator=(Generator&& other) noexcept { std::swap(m_coroutine, other.m_coroutine); return *this; }
+    ~Generator() { if (m_coroutine) m_coroutine.destroy(); }
+
+    // Runs up to the first value, so only call it once
+    iterator begin() { resume(m_coroutine); return iterator(m_coroutine); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+
+    // Anything the coroutine threw comes out here, in the caller's thread
+    static void resume(std::coroutine_handle<promise_type> coroutine) {
+        coroutine.resume();
+        if (coroutine.done() && coroutine.promise().error)
+            std::rethrow_exception(std::exchange(coroutine.promise().error, nullptr));
+    }
+
+    std::coroutine_handle<promise_type> m_coroutine;
+};
@@ -2,32 +2,69 @@
 
 #include "simd.h"
 
-#include <cstdint>    // uint64_t
-#include <functional> // function
+#include <cstddef>  // ptrdiff_t
+#include <cstdint>  // uint32_t
+#include <iterator> // default_sentinel, default_sentinel_t
+#include <ranges>   // view_interface
 
 
-struct Vertex;
-struct Edge;
-struct Face;
+// Elements link to each other by handle, their position in the arena the Manifold holding them keeps them in. Links
+// are half the size of pointers, and only mean anything alongside the arenas, see Manifold for following them.
+inline constexpr uint32_t noHandle = ~0u;
 
-struct Halfedge {
-    Halfedge *next, *prev, *flip;
-    Vertex *v;
-    Edge *e;
-    Face *f;
+struct Halfedge;
+
+// Circulates a closed loop of halfedges, visiting each once, starting from the one it was given. Steps follow the
+// links through the halfedge arena, and the loop yields handles into it.
+template <class Step>
+class HalfedgeRing : public std::ranges::view_interface<HalfedgeRing<Step>> {
+public:
+    class iterator {
+    public:
+        using value_type = uint32_t;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        iterator(const Halfedge* halfedges, uint32_t start) : m_halfedges(halfedges), m_it(start), m_start(start) {}
+
+        uint32_t operator*() const { return m_it; }
+
+        // Falls off the end as soon as the loop comes back around
+        iterator& operator++() { if ((m_it = Step{}(m_halfedges, m_it)) == m_start) m_it = noHandle; return *this; }
+        iterator operator++(int) { iterator old = *this; ++*this; return old; }
+
+        bool operator==(const iterator&) const = default;
+        bool operator==(std::default_sentinel_t) const { return m_it == noHandle; }
 
-    uint64_t collapse();
+    private:
+        const Halfedge *m_halfedges = nullptr;
+        uint32_t m_it = noHandle, m_start = noHandle;
+    };
+
+    HalfedgeRing() = default;
+    HalfedgeRing(const Halfedge* halfedges, uint32_t start) : m_halfedges(halfedges), m_start(start) {}
+
+    iterator begin() const { return iterator(m_halfedges, m_start); }
+    std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+    const Halfedge *m_halfedges = nullptr;
+    uint32_t m_start = noHandle;
+};
+
+struct Halfedge {
+    uint32_t next, prev, flip;
+    uint32_t v, e, f;
 
     void invalidate();
     bool invalid() const;
 };
 
 struct Vertex {
-    Halfedge *he;
+    uint32_t he;
     f32v3 pos;
 
-    void traverseEdges(std::function<void(Halfedge*)> op) const;
-
+    // The draw function is in draw.cpp, with the viewer
     void draw() const;
 
     void invalidate();
@@ -35,28 +72,27 @@ struct Vertex {
 };
 
 struct Edge {
-    Halfedge *he;
+    uint32_t he;
     //bool dirty, unsafe;
 
-    f32v3 midpoint() const;
-
-    void draw() const;
-
     void invalidate();
     bool invalid() const;
 };
 
 struct Face {
-    Halfedge *he;
+    uint32_t he;
 
-    f32v3 normal() const;
-    f32v3 centroid() const;
-    bool isTriangle() const;
+    void invalidate();
+    bool invalid() const;
+};
 
-    void traversePerimeter(std::function<void(Halfedge*)> op) const;
 
-    void draw() const;
+// Every halfedge leaving a vertex, in order around its one-ring
+struct AroundVertex {
+    uint32_t operator()(const Halfedge* halfedges, uint32_t it) const { return halfedges[halfedges[it].flip].next; }
+};
 
-    void invalidate();
-    bool invalid() const;
+// Every halfedge bounding a face, in winding order
+struct AroundFace {
+    uint32_t operator()(const Halfedge* halfedges, uint32_t it) const { return halfedges[it].next; }
 };
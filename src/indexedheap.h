@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm> // max, min
+#include <cstddef>   // size_t
+#include <cstdint>   // uint32_t, uint64_t
+#include <vector>    // vector
+
+
+// Counters for judging how much work a queue did
+struct QueueStats {
+    uint64_t pushes = 0ul, pops = 0ul, updates = 0ul, removals = 0ul;
+    size_t peakSize = 0ul;
+};
+
+// D-ary min-heap of element pointers where each element stores its own slot, so a key can change or an
+// element can leave from anywhere in the heap. The slot member reads npos whenever the element is not queued.
+template <class Element, uint32_t Element::*Slot, unsigned Arity = 4u>
+class IndexedHeap {
+public:
+    static constexpr uint32_t npos = ~0u;
+
+    ~IndexedHeap() { clear(); }
+
+    void reserve(size_t count) { m_entries.reserve(count); }
+    bool empty() const { return m_entries.empty(); }
+    size_t size() const { return m_entries.size(); }
+    const QueueStats& stats() const { return m_stats; }
+
+    static bool contains(const Element* element) { return element->*Slot != npos; }
+
+    Element* top() const { return m_entries.front().element; }
+    float topKey() const { return m_entries.front().key; }
+
+    void push(Element* element, float key) {
+        m_entries.push_back({ key, element });
+        siftUp(static_cast<uint32_t>(m_entries.size() - 1ul));
+
+        ++m_stats.pushes;
+        m_stats.peakSize = std::max(m_stats.peakSize, m_entries.size());
+    }
+
+    // Replaces everything queued with elements, keys[i] being the key of elements[i], sifting them into place from
+    // the bottom up in linear time rather than a push at a time. The layout depends only on the order they come in.
+    void assign(const std::vector<Element*>& elements, const std::vector<float>& keys) {
+        clear();
+        m_entries.reserve(elements.size());
+        for (size_t i = 0ul; i < elements.size(); ++i) {
+            m_entries.push_back({ keys[i], elements[i] });
+            elements[i]->*Slot = static_cast<uint32_t>(i);
+        }
+
+        // Every slot past the last one with children is already a heap of one
+        const size_t parents = m_entries.size() > 1ul ? (m_entries.size() - 2ul) / Arity + 1ul : 0ul;
+        for (size_t slot = parents; slot-- > 0ul;)
+            siftDown(static_cast<uint32_t>(slot));
+
+        m_stats.pushes += elements.size();
+        m_stats.peakSize = std::max(m_stats.peakSize, m_entries.size());
+    }
+
+    Element* pop() {
+        Element *element = top();
+        erase(0u);
+        ++m_stats.pops;
+        return element;
+    }
+
+    // Moves the element up or down to suit its new key
+    void update(Element* element, float key) {
+        const uint32_t slot = element->*Slot;
+        const float old = m_entries[slot].key;
+        m_entries[slot].key = key;
+
+        if (key < old)
+            siftUp(slot);
+        else
+            siftDown(slot);
+        ++m_stats.updates;
+    }
+
+    void remove(Element* element) {
+        erase(element->*Slot);
+        ++m_stats.removals;
+    }
+
+    // Leaves every element it held marked as not queued
+    void clear() {
+        for (const Entry &entry : m_entries)
+            entry.element->*Slot = npos;
+        m_entries.clear();
+    }
+
+private:
+    struct Entry {
+        float key;
+        Element *element;
+    };
+
+    void place(uint32_t slot, const Entry& entry) {
+        m_entries[slot] = entry;
+        entry.element->*Slot = slot;
+    }
+
+    // The last entry fills the hole and then finds its level
+    void erase(uint32_t slot) {
+        m_entries[slot].element->*Slot = npos;
+
+        const Entry last = m_entries.back();
+        m_entries.pop_back();
+        if (slot < m_entries.size()) {
+            place(slot, last);
+            siftUp(slot);
+            siftDown(last.element->*Slot);
+        }
+    }
+
+    void siftUp(uint32_t slot) {
+        const Entry moving = m_entries[slot];
+        while (slot > 0u) {
+            const uint32_t parent = (slot - 1u) / Arity;
+            if (!(moving.key < m_entries[parent].key))
+                break;
+            place(slot, m_entries[parent]);
+            slot = parent;
+        }
+        place(slot, moving);
+    }
+
+    void siftDown(uint32_t slot) {
+        const Entry moving = m_entries[slot];
+        const size_t count = m_entries.size();
+        for (;;) {
+            const size_t first = size_t(slot) * Arity + 1ul;
+            if (first >= count)
+                break;
+
+            size_t best = first;
+            for (size_t child = first + 1ul; child < std::min(first + Arity, count); ++child)
+                if (m_entries[child].key < m_entries[best].key)
+                    best = child;
+
+            if (!(m_entries[best].key < moving.key))
+                break;
+            place(slot, m_entries[best]);
+            slot = static_cast<uint32_t>(best);
+        }
+        place(slot, moving);
+    }
+
+    std::vector<Entry> m_entries;
+    QueueStats m_stats;
+};
+
+// Unordered pool of element pointers that can be sampled by index, each element stores its own slot so it can leave
+// in constant time. Shares the slot convention of IndexedHeap, so an element can be in at most one of them.
+template <class Element, uint32_t Element::*Slot>
+class IndexedPool {
+public:
+    static constexpr uint32_t npos = ~0u;
+
+    ~IndexedPool() { clear(); }
+
+    void reserve(size_t count) { m_elements.reserve(count); }
+    bool empty() const { return m_elements.empty(); }
+    size_t size() const { return m_elements.size(); }
+    const QueueStats& stats() const { return m_stats; }
+
+    static bool contains(const Element* element) { return element->*Slot != npos; }
+
+    Element* operator[](size_t slot) const { return m_elements[slot]; }
+
+    void push(Element* element) {
+        element->*Slot = static_cast<uint32_t>(m_elements.size());
+        m_elements.push_back(element);
+
+        ++m_stats.pushes;
+        m_stats.peakSize = std::max(m_stats.peakSize, m_elements.size());
+    }
+
+    // The last element fills the hole
+    void remove(Element* element) {
+        const uint32_t slot = element->*Slot;
+        element->*Slot = npos;
+
+        Element *last = m_elements.back();
+        m_elements.pop_back();
+        if (slot < m_elements.size()) {
+            m_elements[slot] = last;
+            last->*Slot = slot;
+        }
+        ++m_stats.removals;
+    }
+
+    void clear() {
+        for (Element *element : m_elements)
+            element->*Slot = npos;
+        m_elements.clear();
+    }
+
+private:
+    std::vector<Element*> m_elements;
+    QueueStats m_stats;
+};
@@ -1,8 +1,16 @@
 #include "collapsible.h"
 #include "Timer.h"
 
-#include <cmath>         // tan
-#include <GL/freeglut.h> // glut*, gl*
+#include <algorithm>          // max
+#include <atomic>             // atomic
+#include <cmath>              // tan
+#include <condition_variable> // condition_variable
+#include <exception>          // exception
+#include <GL/freeglut.h>      // glut*, gl*
+#include <iostream>           // cerr, cout, endl
+#include <mutex>              // mutex, unique_lock, lock_guard
+#include <string>             // string, stoul
+#include <thread>             // thread
 
 
 int windowWidth = 1440, windowHeight = 900;
@@ -14,6 +22,14 @@ Collapsible *shape;
 bool showFaces = true, showEdges = false, showVertices = false;
 bool toggle = false;
 
+// Simplification runs on a worker thread that holds shapeMutex for as long as it works. Between steps the mesh is whole,
+// and the worker lets go of it to a frame that wants it and for as long as it is paused.
+constexpr unsigned frameMillis = 16u;
+std::thread worker;
+std::mutex shapeMutex;
+std::condition_variable shapeReleased;
+std::atomic<bool> working = false, frameWanted = false, paused = false, cancelled = false;
+
 // mouse state
 int prevX = 0, prevY = 0;
 bool leftPressed = false, rightPressed = false, middlePressed = false;
@@ -63,10 +79,16 @@ static void resetViewMatrix() {
     ::focus[2] = -::shape->getAABBSizes().max();
 }
 
+static void simplifyInBackground();
+
 ////////////////////
 // GLUT CALLBACKS //
 ////////////////////
 static void display() {
+    // Wait for the worker to finish its step, then draw the mesh as it stands
+    ::frameWanted = true;
+    std::unique_lock lock(::shapeMutex);
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     { // Set up scene
@@ -90,6 +112,10 @@ static void display() {
             ::shape->drawFaces();
     }
 
+    ::frameWanted = false;
+    lock.unlock();
+    ::shapeReleased.notify_all();
+
     // Submit
     glFlush();
     glutSwapBuffers();
@@ -147,20 +173,64 @@ static void motion(int x, int y) {
     glutPostRedisplay();
 }
 
+// Every level simplified once is recorded, so reaching it again is just a walk through the history. Only when
+// the history runs out does the rest get simplified, in the background.
+static void reachTarget() {
+    {
+        Timer t("Replaying History");
+        ::shape->setFaceCount(::target);
+    }
+    if (::shape->faceCount() > ::target)
+        ::simplifyInBackground();
+    else
+        std::cout << ::shape->faceCount() << " faces" << std::endl;
+}
+
+// Wakes a paused worker, which only sleeps while it has let go of the mesh
+static void resumeWorker() {
+    {
+        std::lock_guard lock(::shapeMutex);
+        ::paused = false;
+    }
+    ::shapeReleased.notify_all();
+}
+
 static void keyboard(unsigned char key, int x, int y) {
+    // The mesh belongs to the worker until it is done, only pausing and cancelling reach it
+    if (::working) {
+        if (key == ' ') {
+            if (::paused)
+                ::resumeWorker();
+            else
+                ::paused = true;
+            std::cout << (::paused ? "Paused" : "Resumed") << std::endl;
+        } else if (key == 'c') {
+            ::cancelled = true;
+            ::resumeWorker();
+        }
+        return;
+    }
+
     switch(key) {
     case ' ':
         if (::simplified) {
-            Timer t("Loading Shape");
-            delete ::shape;
-            ::shape = new Collapsible(::fileName);
+            Timer t("Restoring Shape");
+            ::shape->setFaceCount(~0ul);
+            std::cout << ::shape->faceCount() << " faces" << std::endl;
         } else {
-            Timer t("Simplifying Shape");
-            ::shape->simplify(::target);
+            ::reachTarget();
         }
         ::simplified = !::simplified;
         break;
 
+    case '-':
+    case '=':
+        // Halve or double the target
+        ::target = key == '-' ? std::max(1u, ::target / 2u) : ::target * 2u;
+        if (::simplified)
+            ::reachTarget();
+        break;
+
     case 'p':
         ::showVertices = !::showVertices;
         break;
@@ -235,16 +305,68 @@ static void specialkey(int key, int x, int y) {
     }
 }
 
+////////////
+// WORKER //
+////////////
+// Redraws at a steady rate while the worker runs, then collects it
+static void tick(int) {
+    if (::working) {
+        glutPostRedisplay();
+        glutTimerFunc(::frameMillis, ::tick, 0);
+    } else {
+        ::worker.join();
+        std::cout << ::shape->faceCount() << " faces" << std::endl;
+        glutPostRedisplay();
+    }
+}
+
+static void simplifyInBackground() {
+    ::paused = ::cancelled = false;
+    ::working = true;
+
+    ::worker = std::thread([target = ::target] {
+        {
+            Timer t("Simplifying Shape");
+            std::unique_lock lock(::shapeMutex);
+
+            // Steps short enough that a frame never waits long for one to end
+            const uint64_t stride = std::max<uint64_t>(1'024u, ::shape->faceCount() / 256u);
+            for ([[maybe_unused]] const SimplifyResult &step : ::shape->simplifySteps(target, stride, { .record = true })) {
+                if (::frameWanted)
+                    ::shapeReleased.wait(lock, [] { return !::frameWanted; });
+                ::shapeReleased.wait(lock, [] { return !::paused || ::cancelled; });
+                if (::cancelled)
+                    break;
+            }
+        }
+        ::working = false;
+    });
+
+    glutTimerFunc(::frameMillis, ::tick, 0);
+}
+
+
 //////////
 // MAIN //
 //////////
 int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <mesh> [faces]" << std::endl;
+        return 1;
+    }
+
     // Load the model
-    ::fileName = "...";
-    ::target = 2'000u;
-    {
+    ::fileName = argv[1];
+    try {
+        ::target = argc > 2 ? std::stoul(argv[2]) : 2'000u;
         Timer t("Loading Shape");
         ::shape = new Collapsible(::fileName);
+    } catch (const std::string& error) {
+        std::cerr << error << std::endl;
+        return 1;
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
     }
 
     // Prepare the window
@@ -279,6 +401,11 @@ int main(int argc, char **argv) {
     glutMainLoop();
 
     // Clean up upon exit
+    if (::worker.joinable()) {
+        ::cancelled = true;
+        ::resumeWorker();
+        ::worker.join();
+    }
     if (::shape) {
         delete ::shape;
         ::shape = nullptr;
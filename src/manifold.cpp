@@ -1,12 +1,11 @@
 #include "manifold.h"
 
-#include <cctype>    // isdigit
-#include <fstream>   // ifstream
-#include <GL/gl.h>   // glBegin, glEnd, glMaterialfv, GL_*
-#include <iterator>  // next
+#include "flathash.h"
+#include "parallel.h"
+
+#include <algorithm> // find_if, max, min
 #include <limits>    // numeric_limits::min, max
-#include <map>       // map
-#include <string>    // string, getline
+#include <string>    // string
 
 using namespace std;
 
@@ -52,33 +51,34 @@ template <class VertexType, class EdgeType>
 void Manifold<VertexType, EdgeType>::verifyConnections() {
     for (const auto &halfedge : m_halfedges) {
         if (!halfedge.invalid()) {
-            if (halfedge.v->he == nullptr)
+            if (m_vertices[halfedge.v].invalid())
                 throw 1u<<0u;
-            if (halfedge.e->he == nullptr)
+            if (m_edges[halfedge.e].invalid())
                 throw 1u<<1u;
-            if (halfedge.f->he == nullptr)
+            if (m_faces[halfedge.f].invalid())
                 throw 1u<<2u;
-            if (halfedge.flip->flip != &halfedge)
+            if (m_halfedges[halfedge.flip].flip != handle(&halfedge))
                 throw 1u<<3u;
         }
     }
 
     for (const auto &vertex : m_vertices)
-        if (!vertex.invalid() && vertex.he->v != &vertex)
+        if (!vertex.invalid() && m_halfedges[vertex.he].v != handle(&vertex))
                 throw 1u<<4u;
 
     for (const auto &edge : m_edges)
-        if (!edge.invalid() && edge.he->e != &edge)
+        if (!edge.invalid() && m_halfedges[edge.he].e != handle(&edge))
                 throw 1u<<5u;
 
     for (const auto &face : m_faces) {
         if (!face.invalid()) {
-            if (face.he->f != &face)
+            const Halfedge &he = m_halfedges[face.he];
+            if (he.f != handle(&face))
                 throw 1u<<6u;
             if (m_trianglesOnly) {
-                if (face.he->next->next->next != face.he)
+                if (m_halfedges[m_halfedges[he.next].next].next != face.he)
                     throw 1u<<7u;
-                if (face.he->prev->prev->prev != face.he)
+                if (m_halfedges[m_halfedges[he.prev].prev].prev != face.he)
                     throw 1u<<8u;
             }
         }
@@ -87,86 +87,142 @@ void Manifold<VertexType, EdgeType>::verifyConnections() {
 #endif
 
 template <class VertexType, class EdgeType>
-Manifold<VertexType, EdgeType>::Manifold(const char* objfile) : m_trianglesOnly(true) {
-    ifstream file(objfile);
-    vector<Vertex*> vertexPointers;
-    using EdgeKey = pair<const Vertex*, const Vertex*>;
-    map<EdgeKey, Edge*> edgeHash;
-
-    if (!file.is_open())
-        throw string("Could not open file ") + objfile;
-    while (!file.eof()) {
-        string token;
-        file >> token;
-        if (token[0] == '#') {
-            // Discard comments
-            getline(file, token);
-        } else if (token[0] == 'v' && token[1] != 'n') {
-            // Process vertices, discard normals
-            f32v3 p;
-            file >> p;
-
-            m_bounds.addSample(p);
-
-            m_vertices.emplace_back(nullptr, p);
-            vertexPointers.push_back(&m_vertices.back());
-        } else if (token[0] == 'f') {
-            // Process faces
-            list<Vertex*> faceVerts;
-            file >> ws;
-            while (isdigit(file.peek())) {
-                string vnum;
-                file >> vnum >> ws;
-
-                // Again, discard indices to textures and normals
-                if (size_t found = vnum.find("/"); found != string::npos)
-                    vnum = vnum.substr(0, found);
-
-                faceVerts.push_back(vertexPointers[stoul(vnum) - 1]);
+Manifold<VertexType, EdgeType>::Manifold() : m_removedFaces(0ul), m_trianglesOnly(true) {
+}
+
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::build(const MeshData& mesh) {
+    // Points and lines have no place in a manifold
+    auto degreeOf = [&](size_t face) { return mesh.faceStarts[face + 1] - mesh.faceStarts[face]; };
+
+    size_t faceCount = 0ul, cornerCount = 0ul;
+    for (size_t face = 0ul; face < mesh.faceCount(); ++face) {
+        if (const size_t degree = degreeOf(face); degree >= 3ul) {
+            ++faceCount;
+            cornerCount += degree;
+        }
+    }
+
+    // First pass numbers the edges in order of first use. They are keyed on their two vertex indices,
+    // larger one in the high bits. A closed mesh has half as many edges as corners, so that's all the
+    // table needs to hold.
+    vector<uint32_t> cornerEdges;
+    cornerEdges.reserve(cornerCount);
+    uint32_t edgeCount = 0u;
+    {
+        FlatHashMap<uint64_t, uint32_t> edgeHash(cornerCount / 2ul, ~0ull);
+        for (size_t face = 0ul; face < mesh.faceCount(); ++face) {
+            const uint32_t *corners = mesh.indices.data() + mesh.faceStarts[face];
+            const size_t degree = degreeOf(face);
+            if (degree < 3ul)
+                continue;
+
+            for (size_t corner = 0ul; corner < degree; ++corner) {
+                const uint32_t index = corners[corner], nextIndex = corners[(corner + 1) % degree];
+                if (index >= mesh.positions.size() || nextIndex >= mesh.positions.size())
+                    throw string("Face references a missing vertex");
+
+                const uint64_t key = uint64_t(max(index, nextIndex)) << 32u | min(index, nextIndex);
+                cornerEdges.push_back(*edgeHash.tryEmplace(key, edgeCount).first);
+                if (cornerEdges.back() == edgeCount)
+                    ++edgeCount;
             }
+        }
+    }
 
-            if (faceVerts.size() > 3ul)
-                m_trianglesOnly = false;
+    // Now everything can be allocated exactly once
+    m_vertices.reserve(mesh.positions.size());
+    m_faces.reserve(faceCount);
+    m_edges.reserve(edgeCount);
+    m_halfedges.reserve(cornerCount);
 
-            m_faces.emplace_back(nullptr);
-            Halfedge *first = nullptr, *prev = nullptr;
+    for (const f32v3 &p : mesh.positions) {
+        m_bounds.addSample(p);
+        m_vertices.emplace_back(noHandle, p);
+    }
 
-            for (auto index = faceVerts.begin(); index != faceVerts.end(); ++index) {
-                auto nextIndex = next(index);
-                if (nextIndex == faceVerts.end())
-                    nextIndex = faceVerts.begin();
+    // Second pass, pair up the flips
+    auto cornerEdge = cornerEdges.begin();
+    for (size_t face = 0ul; face < mesh.faceCount(); ++face) {
+        const uint32_t *corners = mesh.indices.data() + mesh.faceStarts[face];
+        const size_t degree = degreeOf(face);
+        if (degree < 3ul)
+            continue;
 
-                Edge *edge = nullptr;
+        if (degree > 3ul)
+            m_trianglesOnly = false;
 
-                const EdgeKey key(max(*index, *nextIndex), min(*index, *nextIndex));
-                if (auto result = edgeHash.find(key); result != edgeHash.end()) {
-                    edge = result->second;
-                } else {
-                    m_edges.emplace_back(nullptr);
-                    edge = edgeHash[key] = &m_edges.back();
-                }
+        const uint32_t f = static_cast<uint32_t>(m_faces.size());
+        m_faces.emplace_back(noHandle);
+        uint32_t first = noHandle, prev = noHandle;
 
-                m_halfedges.emplace_back(nullptr, prev, edge->he, *index, edge, &m_faces.back());
-                if (index != faceVerts.begin())
-                    prev->next = &m_halfedges.back();
+        for (size_t corner = 0ul; corner < degree; ++corner) {
+            const uint32_t edgeIndex = *cornerEdge++;
+            if (edgeIndex == m_edges.size())
+                m_edges.emplace_back(noHandle);
 
-                if (edge->he)
-                    edge->he->flip = &m_halfedges.back();
+            const uint32_t from = corners[corner], he = static_cast<uint32_t>(m_halfedges.size());
+            Edge &edge = m_edges[edgeIndex];
 
-                edge->he = prev = &m_halfedges.back();
+            m_halfedges.emplace_back(noHandle, prev, edge.he, from, edgeIndex, f);
+            if (corner)
+                m_halfedges[prev].next = he;
 
-                if (!first)
-                    first = prev;
+            if (edge.he != noHandle)
+                m_halfedges[edge.he].flip = he;
 
-                prev->v->he = prev;
-            }
+            edge.he = prev = he;
 
-            prev->next = first;
-            first->prev = m_faces.back().he = &m_halfedges.back();
+            if (first == noHandle)
+                first = prev;
+
+            m_vertices[from].he = prev;
         }
+
+        m_halfedges[prev].next = first;
+        m_halfedges[first].prev = m_faces.back().he = prev;
+    }
+
+#ifndef NDEBUG
+    verifyConnections();
+#endif
+}
+
+template <class VertexType, class EdgeType>
+void Manifold<VertexType, EdgeType>::buildFromCache(const MeshCache& cache) {
+    m_vertices.reserve(cache.positions().size());
+    for (const f32v3 &p : cache.positions()) {
+        m_bounds.addSample(p);
+        m_vertices.emplace_back(noHandle, p);
+    }
+
+    m_edges.reserve(cache.edgeHalfedges().size());
+    for (size_t i = 0ul; i < cache.edgeHalfedges().size(); ++i)
+        m_edges.emplace_back(noHandle);
+
+    m_faces.resize(cache.faceHalfedges().size(), { noHandle });
+    m_halfedges.resize(cache.halfedges().size());
+
+    // Every element has its place, wire them up once each link is known to land inside its arena
+    auto link = [](const auto& arena, uint32_t index) {
+        if (index >= arena.size())
+            throw string("Mesh cache links out of bounds");
+        return index;
+    };
+
+    for (size_t i = 0ul; i < m_halfedges.size(); ++i) {
+        const HalfedgeLinks &l = cache.halfedges()[i];
+        m_halfedges[i] = { link(m_halfedges, l.next), link(m_halfedges, l.prev), link(m_halfedges, l.flip),
+                           link(m_vertices, l.v), link(m_edges, l.e), link(m_faces, l.f) };
     }
+    for (size_t i = 0ul; i < m_vertices.size(); ++i)
+        m_vertices[i].he = link(m_halfedges, cache.vertexHalfedges()[i]);
+    for (size_t i = 0ul; i < m_edges.size(); ++i)
+        m_edges[i].he = link(m_halfedges, cache.edgeHalfedges()[i]);
+    for (size_t i = 0ul; i < m_faces.size(); ++i)
+        m_faces[i].he = link(m_halfedges, cache.faceHalfedges()[i]);
 
-    file.close();
+    m_trianglesOnly = cache.header().trianglesOnly;
 
 #ifndef NDEBUG
     verifyConnections();
@@ -174,61 +230,274 @@ Manifold<VertexType, EdgeType>::Manifold(const char* objfile) : m_trianglesOnly(
 }
 
 template <class VertexType, class EdgeType>
-f32v3 Manifold<VertexType, EdgeType>::getAABBSizes() const {
-    return { m_bounds.x.delta(), m_bounds.y.delta(), m_bounds.z.delta() };
+MeshCache::Writer Manifold<VertexType, EdgeType>::startCache(const char* source, uint32_t qefSize) const {
+    MeshCache::Header header{};
+    header.trianglesOnly = m_trianglesOnly;
+    header.stamp = MeshCache::stampFor(source, qefSize);
+    header.vertexCount = m_vertices.size();
+    header.edgeCount = m_edges.size();
+    header.faceCount = m_faces.size();
+    header.halfedgeCount = m_halfedges.size();
+    MeshCache::Writer writer(source, header);
+
+    vector<f32v3> positions;
+    vector<uint32_t> vertexHalfedges;
+    positions.reserve(m_vertices.size());
+    vertexHalfedges.reserve(m_vertices.size());
+    for (const VertexType &vertex : m_vertices) {
+        positions.push_back(vertex.pos);
+        vertexHalfedges.push_back(vertex.he);
+    }
+    writer.section(positions.data(), positions.size() * sizeof(f32v3));
+    writer.section(vertexHalfedges.data(), vertexHalfedges.size() * sizeof(uint32_t));
+
+    vector<uint32_t> edgeHalfedges;
+    edgeHalfedges.reserve(m_edges.size());
+    for (const EdgeType &edge : m_edges)
+        edgeHalfedges.push_back(edge.he);
+    writer.section(edgeHalfedges.data(), edgeHalfedges.size() * sizeof(uint32_t));
+
+    vector<uint32_t> faceHalfedges;
+    faceHalfedges.reserve(m_faces.size());
+    for (const Face &face : m_faces)
+        faceHalfedges.push_back(face.he);
+    writer.section(faceHalfedges.data(), faceHalfedges.size() * sizeof(uint32_t));
+
+    vector<HalfedgeLinks> links;
+    links.reserve(m_halfedges.size());
+    for (const Halfedge &he : m_halfedges)
+        links.push_back({ he.next, he.prev, he.flip, he.v, he.e, he.f });
+    writer.section(links.data(), links.size() * sizeof(HalfedgeLinks));
+
+    // Callers append their own per vertex data before finishing
+    return writer;
 }
 
 template <class VertexType, class EdgeType>
-f32v3 Manifold<VertexType, EdgeType>::getAABBCentroid() const {
-    return { m_bounds.x.centroid(), m_bounds.y.centroid(), m_bounds.z.centroid() };
+Manifold<VertexType, EdgeType>::Manifold(const char* meshfile, LoadMode mode) : Manifold() {
+    build(readMesh(meshfile, mode));
+}
+
+template <class VertexType, class EdgeType>
+Manifold<VertexType, EdgeType>::Manifold(const MeshData& mesh) : Manifold() {
+    build(mesh);
+}
+
+template <class VertexType, class EdgeType>
+MeshData Manifold<VertexType, EdgeType>::exportMesh() const {
+    MeshData mesh;
+    vector<uint32_t> indices(m_vertices.size());
+
+    for (const VertexType &vertex : m_vertices) {
+        if (!vertex.invalid()) {
+            indices[handle(&vertex)] = static_cast<uint32_t>(mesh.positions.size());
+            mesh.positions.push_back(vertex.pos);
+        }
+    }
+
+    mesh.faceStarts.reserve(faceCount() + 1ul);
+    for (uint32_t f = 0u; f < m_faces.size(); ++f) {
+        if (!m_faces[f].invalid()) {
+            for (uint32_t he : perimeter(f))
+                mesh.indices.push_back(indices[m_halfedges[he].v]);
+            mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+        }
+    }
+
+    return mesh;
+}
+
+// Where each live element of an arena ends up once the dead ones are squeezed out, counted per block in parallel
+template <class Element>
+static vector<uint32_t> compactedHandles(const vector<Element>& arena, size_t& liveCount) {
+    const size_t blocks = hardwareThreads(), stride = (arena.size() + blocks - 1ul) / blocks;
+    vector<size_t> offsets(blocks + 1ul, 0ul);
+    vector<uint32_t> handles(arena.size());
+
+    parallelFor(blocks, [&](size_t block) {
+        for (size_t i = block * stride; i < min(arena.size(), (block + 1ul) * stride); ++i)
+            offsets[block + 1ul] += !arena[i].invalid();
+    });
+    for (size_t block = 0ul; block < blocks; ++block)
+        offsets[block + 1ul] += offsets[block];
+
+    parallelFor(blocks, [&](size_t block) {
+        uint32_t next = static_cast<uint32_t>(offsets[block]);
+        for (size_t i = block * stride; i < min(arena.size(), (block + 1ul) * stride); ++i)
+            handles[i] = arena[i].invalid() ? ~0u : next++;
+    });
+
+    liveCount = offsets.back();
+    return handles;
+}
+
+template <class VertexType, class EdgeType>
+size_t Manifold<VertexType, EdgeType>::compact() {
+    const size_t before = m_vertices.capacity() * sizeof(VertexType) + m_faces.capacity() * sizeof(Face)
+                        + m_edges.capacity() * sizeof(EdgeType) + m_halfedges.capacity() * sizeof(Halfedge);
+
+    size_t vertexCount, faceCount, edgeCount, halfedgeCount;
+    const vector<uint32_t> vertexHandles = compactedHandles(m_vertices, vertexCount),
+                           faceHandles = compactedHandles(m_faces, faceCount),
+                           edgeHandles = compactedHandles(m_edges, edgeCount),
+                           halfedgeHandles = compactedHandles(m_halfedges, halfedgeCount);
+
+    vector<VertexType> vertices;
+    vector<Face> faces(faceCount, { noHandle });
+    vector<EdgeType> edges;
+    vector<Halfedge> halfedges(halfedgeCount);
+
+    // Vertex and edge types need not be default constructible, so copy the first live one as filler
+    auto firstLive = [](const auto& arena) { return *find_if(arena.begin(), arena.end(), [](const auto& e){ return !e.invalid(); }); };
+    if (vertexCount)
+        vertices.resize(vertexCount, firstLive(m_vertices));
+    if (edgeCount)
+        edges.resize(edgeCount, firstLive(m_edges));
+
+    // Every cross reference is rewritten as the element moves to its new slot
+    parallelFor(m_halfedges.size(), [&](size_t i) {
+        if (const Halfedge &he = m_halfedges[i]; !he.invalid())
+            halfedges[halfedgeHandles[i]] = { halfedgeHandles[he.next], halfedgeHandles[he.prev], halfedgeHandles[he.flip],
+                                              vertexHandles[he.v], edgeHandles[he.e], faceHandles[he.f] };
+    });
+    parallelFor(m_vertices.size(), [&](size_t i) {
+        if (const VertexType &vertex = m_vertices[i]; !vertex.invalid()) {
+            VertexType &moved = vertices[vertexHandles[i]] = vertex;
+            moved.he = halfedgeHandles[vertex.he];
+        }
+    });
+    parallelFor(m_edges.size(), [&](size_t i) {
+        if (const EdgeType &edge = m_edges[i]; !edge.invalid()) {
+            EdgeType &moved = edges[edgeHandles[i]] = edge;
+            moved.he = halfedgeHandles[edge.he];
+        }
+    });
+    parallelFor(m_faces.size(), [&](size_t i) {
+        if (const Face &face = m_faces[i]; !face.invalid())
+            faces[faceHandles[i]].he = halfedgeHandles[face.he];
+    });
+
+    m_vertices.swap(vertices);
+    m_faces.swap(faces);
+    m_edges.swap(edges);
+    m_halfedges.swap(halfedges);
+    m_removedFaces = 0ul;
+
+#ifndef NDEBUG
+    verifyConnections();
+#endif
+
+    const size_t after = m_vertices.capacity() * sizeof(VertexType) + m_faces.capacity() * sizeof(Face)
+                       + m_edges.capacity() * sizeof(EdgeType) + m_halfedges.capacity() * sizeof(Halfedge);
+    return before - after;
+}
+
+template <class VertexType, class EdgeType>
+f32v3 Manifold<VertexType, EdgeType>::normal(uint32_t f) const {
+    const Halfedge &he = m_halfedges[m_faces[f].he], &next = m_halfedges[he.next], &across = m_halfedges[next.next];
+    return (m_vertices[across.v].pos - m_vertices[he.v].pos).cross(m_vertices[m_halfedges[across.next].v].pos - m_vertices[next.v].pos).normalize();
+}
+
+template <class VertexType, class EdgeType>
+f32v3 Manifold<VertexType, EdgeType>::centroid(uint32_t f) const {
+    uint64_t degree = 0ul;
+    f32v3 sum = {};
+
+    for (uint32_t he : perimeter(f)) {
+        sum += m_vertices[m_halfedges[he].v].pos;
+        ++degree;
+    }
+
+    return sum / degree;
+}
+
+template <class VertexType, class EdgeType>
+bool Manifold<VertexType, EdgeType>::isTriangle(uint32_t f) const {
+    const uint32_t he = m_faces[f].he;
+    return m_halfedges[m_halfedges[m_halfedges[he].next].next].next == he;
+}
+
+template <class VertexType, class EdgeType>
+f32v3 Manifold<VertexType, EdgeType>::midpoint(uint32_t e) const {
+    const uint32_t he = m_edges[e].he;
+    return (m_vertices[m_halfedges[he].v].pos + m_vertices[head(he)].pos) / 2.0f;
+}
+
+template <class VertexType, class EdgeType>
+uint64_t Manifold<VertexType, EdgeType>::surgicalRemoval(uint32_t h) {
+    Halfedge &he = m_halfedges[h], &next = m_halfedges[he.next], &prev = m_halfedges[he.prev];
+
+    if (isTriangle(he.f)) { // Triangles get removed
+        // Update outer flips
+        m_halfedges[prev.flip].flip = next.flip;
+        m_halfedges[next.flip].flip = prev.flip;
+
+        // Update outer edges
+        m_edges[prev.e].he = prev.flip;
+        m_halfedges[next.flip].e = prev.e;
+
+        // Ensure the outside point points to a valid halfedge
+        m_vertices[prev.v].he = next.flip;
+
+        // Mark all these for removal
+        m_edges[next.e].invalidate();
+        prev.invalidate();
+        next.invalidate();
+        m_faces[he.f].invalidate();
+        he.invalidate();
+
+        return 1ul;
+    } else { // More than 3 sides, just a little housekeeping
+        // Make sure the face is not pointing at this particular halfedge
+        m_faces[he.f].he = he.next;
+
+        // Update edges to skip this obselete halfedge
+        prev.next = he.next;
+        next.prev = he.prev;
+
+        // Still marks the halfedge to be removed
+        he.invalidate();
+
+        return 0ul;
+    }
 }
 
 template <class VertexType, class EdgeType>
-void Manifold<VertexType, EdgeType>::drawFaces() const {
-    list<const Face*> nonTris;
-
-    // Should be faster
-    static const GLfloat white[] = { 1.0f, 1.0f, 1.0f };
-    glEnable(GL_LIGHTING);
-    glMaterialfv(GL_FRONT, GL_AMBIENT, white);
-    glBegin(GL_TRIANGLES); {
-        for (const Face &face : m_faces)
-            if (m_trianglesOnly || face.isTriangle())
-                face.draw();
-            else
-                nonTris.push_back(&face);
-    } glEnd();
-
-    // Slower but draws degree 4+ polys correctly
-    static const GLfloat blue[] = { 0.6f, 0.6f, 1.0f };
-    glMaterialfv(GL_FRONT, GL_AMBIENT, blue);
-    for (const Face *face : nonTris) {
-        glBegin(GL_POLYGON); {
-            face->draw();
-        } glEnd();
+uint64_t Manifold<VertexType, EdgeType>::collapse(uint32_t h) {
+    Halfedge &he = m_halfedges[h];
+    const Halfedge &flip = m_halfedges[he.flip];
+
+    // Make this vertex point to a different halfedge with the same root. With only two faces around this vertex that one
+    // lies on the flip's face and goes with it if it is a triangle, but then this face is not and next outlives the collapse.
+    const uint32_t prevFlip = m_halfedges[he.prev].flip;
+    m_vertices[he.v].he = m_halfedges[prevFlip].f == flip.f && isTriangle(flip.f) ? he.next : prevFlip;
+
+    {
+        // While the halfedges are still connected, update the roots of the vertex to be removed
+        const uint32_t condemned = flip.v;
+        for (uint32_t it : outgoing(condemned))
+            m_halfedges[it].v = he.v;
+
+        // Mark this vertex for removal, have to save it off because the above changes flip.v
+        m_vertices[condemned].invalidate();
     }
+
+    // Mark the edge for removal
+    m_edges[he.e].invalidate();
+
+    // Remove everything else very carefully, the flip's side first as this side's removal drops the link to it
+    const uint64_t removed = surgicalRemoval(he.flip);
+    return removed + surgicalRemoval(h);
 }
 
 template <class VertexType, class EdgeType>
-void Manifold<VertexType, EdgeType>::drawEdges() const {
-    static const GLfloat yellow[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-    glDisable(GL_LIGHTING);
-    glColor4fv(yellow);
-    glBegin(GL_LINES); {
-        for (const Edge &edge : m_edges)
-            edge.draw();
-    } glEnd();
+f32v3 Manifold<VertexType, EdgeType>::getAABBSizes() const {
+    return { m_bounds.x.delta(), m_bounds.y.delta(), m_bounds.z.delta() };
 }
 
 template <class VertexType, class EdgeType>
-void Manifold<VertexType, EdgeType>::drawVertices() const {
-    static const GLfloat red[] = { 1.0f, 0.0f, 0.0f, 1.0f };
-    glDisable(GL_LIGHTING);
-    glColor4fv(red);
-    glBegin(GL_POINTS); {
-        for (const Vertex &vertex : m_vertices)
-            vertex.draw();
-    } glEnd();
+f32v3 Manifold<VertexType, EdgeType>::getAABBCentroid() const {
+    return { m_bounds.x.centroid(), m_bounds.y.centroid(), m_bounds.z.centroid() };
 }
 
 
@@ -237,4 +506,7 @@ void Manifold<VertexType, EdgeType>::drawVertices() const {
 //////////////////////////////////////
 #include "errorfunction.h"
 template class Manifold<Vertex, Edge>;
-template class Manifold<QEFVertex, QEFEdge>;
+template class Manifold<QEFVertex<DistanceQEF>, QEFEdge<DistanceQEF>>;
+template class Manifold<QEFVertex<PlaneQEF>, QEFEdge<PlaneQEF>>;
+template class Manifold<QEFVertex<AttributeQEF<2>>, QEFEdge<AttributeQEF<2>>>;
+template class Manifold<QEFVertex<AttributeQEF<3>>, QEFEdge<AttributeQEF<3>>>;
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "halfedge.h"
+#include "meshcache.h"
+#include "meshio.h"
 
-#include <list> // list
+#include <cstdint> // uint32_t
+#include <vector>  // vector
 
 
 template <class VertexType = Vertex, class EdgeType = Edge>
@@ -29,23 +32,81 @@ protected:
     void verifyConnections();
 #endif
 
+    Manifold();
+
+    // Elements live in arenas that are sized once when built and never reallocated, so their
+    // addresses are stable and each one's position in its arena is the 32-bit handle links use
+    uint32_t handle(const Vertex* v) const { return static_cast<uint32_t>(static_cast<const VertexType*>(v) - m_vertices.data()); }
+    uint32_t handle(const Edge* e) const { return static_cast<uint32_t>(static_cast<const EdgeType*>(e) - m_edges.data()); }
+    uint32_t handle(const Face* f) const { return static_cast<uint32_t>(f - m_faces.data()); }
+    uint32_t handle(const Halfedge* he) const { return static_cast<uint32_t>(he - m_halfedges.data()); }
+
+    // Pretty much irreversible, better mean it! Merges the vertex at the end of halfedge he into the one
+    // it leaves, and returns how many faces went with it.
+    uint64_t collapse(uint32_t he);
+
+    void build(const MeshData& mesh);
+    void buildFromCache(const MeshCache& cache);
+    MeshCache::Writer startCache(const char* source, uint32_t qefSize) const;
+
 public:
-    Manifold(const char* objfile);
+    Manifold(const char* meshfile, LoadMode mode = LoadMode::Parallel);
+    Manifold(const MeshData& mesh);
+
+    // Meshes are too big to copy by accident
+    Manifold(const Manifold&) = delete;
+    Manifold& operator=(const Manifold&) = delete;
+
+    // Elements by handle, and the links between them
+    const Halfedge& halfedge(uint32_t he) const { return m_halfedges[he]; }
+    const VertexType& vertex(uint32_t v) const { return m_vertices[v]; }
+    const EdgeType& edge(uint32_t e) const { return m_edges[e]; }
+    const Face& face(uint32_t f) const { return m_faces[f]; }
+
+    // The halfedge after he leaving the same vertex, going around its one-ring, and the vertex he points at
+    uint32_t nextAround(uint32_t he) const { return m_halfedges[m_halfedges[he].flip].next; }
+    uint32_t head(uint32_t he) const { return m_halfedges[m_halfedges[he].flip].v; }
+
+    // Every halfedge leaving vertex v, and every halfedge bounding face f
+    HalfedgeRing<AroundVertex> outgoing(uint32_t v) const { return { m_halfedges.data(), m_vertices[v].he }; }
+    HalfedgeRing<AroundFace> perimeter(uint32_t f) const { return { m_halfedges.data(), m_faces[f].he }; }
+
+    f32v3 normal(uint32_t f) const;
+    f32v3 centroid(uint32_t f) const;
+    bool isTriangle(uint32_t f) const;
+    f32v3 midpoint(uint32_t e) const;
+
+    // Live vertices and faces as a polygon soup, vertices in arena order
+    MeshData exportMesh() const;
+
+    // Packs the live elements into exactly sized arenas, in order, and returns how many bytes that freed
+    size_t compact();
+
+    size_t faceCount() const { return m_faces.size() - m_removedFaces; }
 
     f32v3 getAABBSizes() const;
     f32v3 getAABBCentroid() const;
 
+    // Immediate mode OpenGL, defined in draw.cpp so that only the viewer has to link against it
     void drawFaces() const;
     void drawEdges() const;
     void drawVertices() const;
 
 protected:
-    std::list<VertexType> m_vertices;
-    std::list<Face>          m_faces;
-    std::list<EdgeType>      m_edges;
-    std::list<Halfedge>  m_halfedges;
+    std::vector<VertexType> m_vertices;
+    std::vector<Face>          m_faces;
+    std::vector<EdgeType>      m_edges;
+    std::vector<Halfedge>  m_halfedges;
+
+    // Collapsed faces stay in their arena, invalidated, until compacted away
+    size_t m_removedFaces;
 
 private:
+    // Takes out the face on he's side if it is a triangle, otherwise just he, and returns how many faces went
+    uint64_t surgicalRemoval(uint32_t he);
+
+    void drawFace(uint32_t f) const;
+
     AABB m_bounds;
     bool m_trianglesOnly;
 };
@@ -0,0 +1,43 @@
+#include "mappedfile.h"
+
+#include <fcntl.h>    // open, O_RDONLY
+#include <string>     // string
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
+
+using namespace std;
+
+
+MappedFile::MappedFile(const char* path) : m_data(nullptr), m_size(0ul) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw string("Could not open file ") + path;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw string("Could not stat file ") + path;
+    }
+
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size) {
+        void *mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw string("Could not map file ") + path;
+        }
+
+        // We only ever sweep through front to back
+        madvise(mapping, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(mapping);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        munmap(const_cast<char*>(m_data), m_size);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>     // size_t
+#include <string_view> // string_view
+
+
+// Read-only memory map of an entire file, unmapped on destruction
+class MappedFile {
+public:
+    MappedFile(const char* path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    std::string_view view() const { return { m_data, m_size }; }
+
+private:
+    const char *m_data;
+    size_t m_size;
+};
@@ -0,0 +1,156 @@
+#include "meshcache.h"
+
+#include <atomic>     // atomic
+#include <bit>        // rotl
+#include <cstdio>     // rename, remove
+#include <cstring>    // memcmp, memcpy
+#include <sys/stat.h> // stat
+#include <unistd.h>   // getpid
+
+using namespace std;
+
+
+static constexpr char cacheMagic[8] = { 'S', 'M', 'P', 'L', 'C', 'A', 'C', 'H' };
+
+static size_t padded(size_t bytes) {
+    return (bytes + 7ul) & ~7ul;
+}
+
+// Writers started so far, to tell this process's temporaries apart
+static atomic<uint64_t> writers = 0ul;
+
+
+//////////////
+// Checksum //
+//////////////
+void Checksum::update(const void* data, size_t bytes) {
+    const char *it = static_cast<const char*>(data);
+    for (size_t i = 0ul; i < bytes; i += 8ul) {
+        uint64_t word;
+        memcpy(&word, it + i, sizeof(word));
+        m_hash = rotl((m_hash ^ word) * 0x100000001B3ull, 29);
+    }
+}
+
+
+///////////////
+// MeshCache //
+///////////////
+string MeshCache::pathFor(const char* source, uint32_t qefSize) {
+    return string(source) + "." + to_string(qefSize) + ".smcache";
+}
+
+CacheStamp MeshCache::stampFor(const char* source, uint32_t qefSize) {
+    struct stat info;
+    if (stat(source, &info) != 0)
+        return { 0ul, 0l, qefSize };
+
+    return { static_cast<uint64_t>(info.st_size), info.st_mtim.tv_sec * 1'000'000'000l + info.st_mtim.tv_nsec, qefSize };
+}
+
+bool MeshCache::open(const char* source, uint32_t qefSize) {
+    const string path = pathFor(source, qefSize);
+    if (struct stat info; stat(path.c_str(), &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header))
+        return false;
+
+    m_file = make_unique<MappedFile>(path.c_str());
+    m_header = reinterpret_cast<const Header*>(m_file->data());
+
+    const CacheStamp stamp = stampFor(source, qefSize);
+    const Header &h = *m_header;
+    if (memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) || h.version != version
+     || h.stamp.sourceSize != stamp.sourceSize || h.stamp.sourceModified != stamp.sourceModified
+     || h.stamp.qefSize != stamp.qefSize || offsetOf(6u) != m_file->size())
+        return false;
+
+    Checksum checksum;
+    checksum.update(m_file->data() + sizeof(Header), m_file->size() - sizeof(Header));
+    return checksum.value() == h.checksum;
+}
+
+size_t MeshCache::offsetOf(unsigned section) const {
+    const Header &h = *m_header;
+    const size_t sizes[] = {
+        h.vertexCount * sizeof(f32v3),
+        h.vertexCount * sizeof(uint32_t),
+        h.edgeCount * sizeof(uint32_t),
+        h.faceCount * sizeof(uint32_t),
+        h.halfedgeCount * sizeof(HalfedgeLinks),
+        h.vertexCount * h.stamp.qefSize,
+    };
+
+    size_t offset = sizeof(Header);
+    for (unsigned i = 0u; i < section; ++i)
+        offset += padded(sizes[i]);
+    return offset;
+}
+
+span<const f32v3> MeshCache::positions() const {
+    return { reinterpret_cast<const f32v3*>(m_file->data() + offsetOf(0u)), m_header->vertexCount };
+}
+
+span<const uint32_t> MeshCache::vertexHalfedges() const {
+    return { reinterpret_cast<const uint32_t*>(m_file->data() + offsetOf(1u)), m_header->vertexCount };
+}
+
+span<const uint32_t> MeshCache::edgeHalfedges() const {
+    return { reinterpret_cast<const uint32_t*>(m_file->data() + offsetOf(2u)), m_header->edgeCount };
+}
+
+span<const uint32_t> MeshCache::faceHalfedges() const {
+    return { reinterpret_cast<const uint32_t*>(m_file->data() + offsetOf(3u)), m_header->faceCount };
+}
+
+span<const HalfedgeLinks> MeshCache::halfedges() const {
+    return { reinterpret_cast<const HalfedgeLinks*>(m_file->data() + offsetOf(4u)), m_header->halfedgeCount };
+}
+
+const void* MeshCache::qefs() const {
+    return m_file->data() + offsetOf(5u);
+}
+
+
+///////////////////////
+// MeshCache::Writer //
+///////////////////////
+MeshCache::Writer::Writer(const char* source, const Header& header)
+  : m_path(pathFor(source, header.stamp.qefSize))
+  , m_temporary(m_path + "." + to_string(getpid()) + "-" + to_string(writers++) + ".tmp")
+  , m_file(m_temporary, ios::binary | ios::trunc)
+  , m_header(header) {
+    memcpy(m_header.magic, cacheMagic, sizeof(cacheMagic));
+    m_header.version = version;
+
+    // Placeholder, the real header goes in once the checksum is known
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(Header));
+}
+
+void MeshCache::Writer::section(const void* data, size_t bytes) {
+    static const char zeros[8] = {};
+    const size_t padding = padded(bytes) - bytes;
+
+    m_file.write(static_cast<const char*>(data), bytes);
+    m_file.write(zeros, padding);
+
+    // Checksum the whole words, then the last partial one with its padding
+    const size_t whole = bytes & ~7ul;
+    m_checksum.update(data, whole);
+    if (padding) {
+        char tail[8] = {};
+        memcpy(tail, static_cast<const char*>(data) + whole, bytes - whole);
+        m_checksum.update(tail, sizeof(tail));
+    }
+}
+
+bool MeshCache::Writer::finish() {
+    m_header.checksum = m_checksum.value();
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(Header));
+    m_file.close();
+
+    if (!m_file || rename(m_temporary.c_str(), m_path.c_str()) != 0) {
+        remove(m_temporary.c_str());
+        return false;
+    }
+    return true;
+}
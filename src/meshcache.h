@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mappedfile.h"
+#include "simd.h"
+
+#include <cstdint> // uint32_t, uint64_t
+#include <fstream> // ofstream
+#include <memory>  // unique_ptr
+#include <span>    // span
+#include <string>  // string
+
+
+// A halfedge's connections, as handles into the mesh's element arenas
+struct HalfedgeLinks {
+    uint32_t next, prev, flip, v, e, f;
+};
+
+// Everything needed to check a cache still matches its source file
+struct CacheStamp {
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    uint32_t qefSize;
+};
+
+// Word at a time running hash, every block handed to it must be a multiple of 8 bytes
+class Checksum {
+public:
+    void update(const void* data, size_t bytes);
+    uint64_t value() const { return m_hash; }
+
+private:
+    uint64_t m_hash = 0xCBF29CE484222325ull;
+};
+
+// Binary image of a fully built mesh, stored beside its source as <source>.<QEF size>.smcache so each
+// metric keeps its own. Sections follow the header in this order, each padded to 8 bytes: positions,
+// vertex/edge/face halfedges, halfedge links, then one initial QEF per vertex.
+class MeshCache {
+public:
+    static constexpr uint32_t version = 1u;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t trianglesOnly;
+        CacheStamp stamp;
+        uint64_t vertexCount, edgeCount, faceCount, halfedgeCount;
+        uint64_t checksum;
+    };
+
+    static std::string pathFor(const char* source, uint32_t qefSize);
+    static CacheStamp stampFor(const char* source, uint32_t qefSize);
+
+    // Maps the cache beside source, returns false if it is missing, stale, corrupt or from another version
+    bool open(const char* source, uint32_t qefSize);
+
+    const Header& header() const { return *m_header; }
+    std::span<const f32v3> positions() const;
+    std::span<const uint32_t> vertexHalfedges() const;
+    std::span<const uint32_t> edgeHalfedges() const;
+    std::span<const uint32_t> faceHalfedges() const;
+    std::span<const HalfedgeLinks> halfedges() const;
+    const void* qefs() const;
+
+    // Streams sections out to a temporary file that only replaces the cache once it is complete. The temporary
+    // is named for the process and the writer, so meshes loaded at once never write over each other's.
+    class Writer {
+    public:
+        Writer(const char* source, const Header& header);
+
+        void section(const void* data, size_t bytes);
+        bool finish();
+
+    private:
+        std::string m_path, m_temporary;
+        std::ofstream m_file;
+        Header m_header;
+        Checksum m_checksum;
+    };
+
+private:
+    size_t offsetOf(unsigned section) const;
+
+    std::unique_ptr<MappedFile> m_file;
+    const Header *m_header = nullptr;
+};
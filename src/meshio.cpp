@@ -0,0 +1,850 @@
+#include "meshio.h"
+#include "flathash.h"
+#include "mappedfile.h"
+#include "parallel.h"
+
+#include <algorithm>   // copy, fill, max, min, transform
+#include <bit>         // bit_cast, byteswap, endian
+#include <cctype>      // isdigit, tolower
+#include <charconv>    // from_chars
+#include <cstring>     // memcpy
+#include <filesystem>  // path
+#include <fstream>     // ifstream, ofstream
+#include <iterator>    // begin, end, size
+#include <sstream>     // istringstream
+#include <string>      // string, getline, stol, stoul
+#include <type_traits> // conditional_t
+#include <utility>     // move, pair
+
+using namespace std;
+
+
+///////////
+// Sinks //
+///////////
+// Every reader pushes its records into a sink: vertex(p), corner(index, relative) for each corner of
+// a face followed by endFace(). Relative corners were negative OBJ indices resolved against vertexCount().
+// Formats with attributes per vertex follow each vertex with vertexNormal(n) and vertexUV(t), OBJ lists
+// them on their own with normal(n) and uv(t) and follows each corner with cornerAttributes(uv, normal).
+namespace {
+    // Normals and texture coordinates as OBJ lists them, and which of them each corner picked. A relative pick
+    // is resolved against the list so far and noted, so a chunk's picks can be moved along with its lists.
+    struct OBJAttributes {
+        struct Pick {
+            size_t corner;
+            uint32_t index;
+        };
+
+        vector<f32v3> normals;
+        vector<f32v2> uvs;
+        vector<Pick> normalPicks, uvPicks;
+        vector<size_t> relativeNormalPicks, relativeUVPicks;
+
+        // reference is as written, counting from 1, or back from the latest when negative, 0 for none
+        static void pick(vector<Pick>& picks, vector<size_t>& relative, size_t listed, size_t corner, int64_t reference) {
+            if (reference == 0)
+                return;
+            if (reference < 0)
+                relative.push_back(picks.size());
+            picks.push_back({ corner, static_cast<uint32_t>(reference < 0 ? static_cast<int64_t>(listed) + reference : reference - 1) });
+        }
+    };
+
+    struct MeshDataSink {
+        MeshData &mesh;
+        vector<size_t> *relativeCorners = nullptr;
+        OBJAttributes *attributes = nullptr;
+
+        size_t vertexCount() const { return mesh.positions.size(); }
+
+        void reserve(size_t vertices, size_t faces) {
+            mesh.positions.reserve(vertices);
+            mesh.indices.reserve(faces * 3ul);
+            mesh.faceStarts.reserve(faces + 1ul);
+        }
+
+        void vertex(const f32v3& p) { mesh.positions.push_back(p); }
+        void vertexNormal(const f32v3& n) { mesh.normals.push_back(n); }
+        void vertexUV(const f32v2& t) { mesh.uvs.push_back(t); }
+
+        void normal(const f32v3& n) { if (attributes) attributes->normals.push_back(n); }
+        void uv(const f32v2& t) { if (attributes) attributes->uvs.push_back(t); }
+
+        void corner(uint32_t index, bool relative) {
+            if (relative && relativeCorners)
+                relativeCorners->push_back(mesh.indices.size());
+            mesh.indices.push_back(index);
+        }
+
+        void cornerAttributes(int64_t uv, int64_t normal) {
+            if (attributes) {
+                OBJAttributes::pick(attributes->uvPicks, attributes->relativeUVPicks, attributes->uvs.size(), mesh.indices.size() - 1ul, uv);
+                OBJAttributes::pick(attributes->normalPicks, attributes->relativeNormalPicks, attributes->normals.size(), mesh.indices.size() - 1ul, normal);
+            }
+        }
+
+        void endFace() { mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size())); }
+    };
+
+    // Forwards whole faces on to a MeshStream
+    struct StreamSink {
+        MeshStream &stream;
+        vector<uint32_t> corners;
+        size_t vertices = 0ul;
+
+        size_t vertexCount() const { return vertices; }
+        void reserve(size_t, size_t) {}
+        void vertex(const f32v3& p) { stream.vertex(p); ++vertices; }
+        void vertexNormal(const f32v3&) {}
+        void vertexUV(const f32v2&) {}
+        void normal(const f32v3&) {}
+        void uv(const f32v2&) {}
+        void corner(uint32_t index, bool) { corners.push_back(index); }
+        void cornerAttributes(int64_t, int64_t) {}
+        void endFace() { stream.face(corners.data(), corners.size()); corners.clear(); }
+    };
+}
+
+// Gives each vertex the average normal of its corners and the texture coordinates of its first corner. Corners
+// that point at missing vertices are left for the builder to complain about.
+static void settleAttributes(MeshData& mesh, const OBJAttributes& attributes) {
+    if (!attributes.normalPicks.empty()) {
+        mesh.normals.assign(mesh.positions.size(), {});
+        for (const auto &[corner, index] : attributes.normalPicks) {
+            if (index >= attributes.normals.size())
+                throw string("Face references a missing normal");
+            if (const uint32_t vertex = mesh.indices[corner]; vertex < mesh.positions.size())
+                mesh.normals[vertex] += attributes.normals[index];
+        }
+
+        for (f32v3 &n : mesh.normals)
+            if (n.lengthSqr() > 0.0f)
+                n = n.normalize();
+    }
+
+    if (!attributes.uvPicks.empty()) {
+        mesh.uvs.assign(mesh.positions.size(), {});
+        vector<bool> settled(mesh.positions.size(), false);
+        for (const auto &[corner, index] : attributes.uvPicks) {
+            if (index >= attributes.uvs.size())
+                throw string("Face references missing texture coordinates");
+            if (const uint32_t vertex = mesh.indices[corner]; vertex < mesh.positions.size() && !settled[vertex]) {
+                settled[vertex] = true;
+                mesh.uvs[vertex] = attributes.uvs[index];
+            }
+        }
+    }
+}
+
+
+////////////
+// Stream //
+////////////
+static MeshData readOBJStream(const char* objfile) {
+    ifstream file(objfile);
+    MeshData mesh;
+    OBJAttributes attributes;
+    MeshDataSink sink{ mesh, nullptr, &attributes };
+
+    if (!file.is_open())
+        throw string("Could not open file ") + objfile;
+    while (!file.eof()) {
+        string token;
+        file >> token;
+        if (token[0] == '#') {
+            // Discard comments
+            getline(file, token);
+        } else if (token == "v") {
+            // Process vertices
+            f32v3 p;
+            file >> p;
+
+            sink.vertex(p);
+        } else if (token == "vn") {
+            f32v3 n;
+            file >> n;
+
+            sink.normal(n);
+        } else if (token == "vt") {
+            // A second coordinate is optional, and a third is no use to us
+            getline(file, token);
+            istringstream coordinates(token);
+            f32v2 t = {};
+            coordinates >> t.x >> t.y;
+
+            sink.uv(t);
+        } else if (token == "f") {
+            // Process faces
+            file >> ws;
+            while (isdigit(file.peek())) {
+                string vnum;
+                file >> vnum >> ws;
+
+                // Texture and normal indices follow the vertex's after slashes, either can be left out
+                int64_t uv = 0, normal = 0;
+                if (const size_t first = vnum.find('/'); first != string::npos) {
+                    const size_t second = vnum.find('/', first + 1ul);
+                    if (second != first + 1ul)
+                        uv = stol(vnum.substr(first + 1ul, second - first - 1ul));
+                    if (second != string::npos && second + 1ul < vnum.size())
+                        normal = stol(vnum.substr(second + 1ul));
+                }
+
+                sink.corner(static_cast<uint32_t>(stoul(vnum) - 1), false);
+                sink.cornerAttributes(uv, normal);
+            }
+
+            sink.endFace();
+        }
+    }
+
+    settleAttributes(mesh, attributes);
+    return mesh;
+}
+
+
+////////////
+// Mapped //
+////////////
+namespace {
+    // Cursor over one line of the mapped file, never copies out of it
+    struct LineParser {
+        const char *it, *end;
+
+        bool isSpace(char c) const { return c == ' ' || c == '\t' || c == '\r'; }
+
+        void skipSpace() { while (it != end && isSpace(*it)) ++it; }
+        void skipToken() { while (it != end && !isSpace(*it)) ++it; }
+        bool atEnd() { skipSpace(); return it == end; }
+
+        float readFloat(const char* objfile) {
+            skipSpace();
+            float value = 0.0f;
+            auto [ptr, ec] = from_chars(it, end, value);
+            if (ec != errc())
+                throw string("Malformed vertex in ") + objfile;
+            it = ptr;
+            return value;
+        }
+
+        // One corner of a face, v, v/t, v//n or v/t/n. The vertex comes back resolved, the texture coordinate and normal
+        // references as they were written, 0 for any left out.
+        uint32_t readCorner(size_t vertexCount, int64_t& uv, int64_t& normal, const char* objfile) {
+            const int64_t value = readReference(objfile);
+            if (value == 0)
+                throw string("Malformed face in ") + objfile;
+
+            uv = normal = 0;
+            if (it != end && *it == '/') {
+                ++it;
+                uv = readReference(objfile);
+                if (it != end && *it == '/') {
+                    ++it;
+                    normal = readReference(objfile);
+                }
+            }
+            skipToken();
+
+            // Negative indices count back from the latest vertex
+            return static_cast<uint32_t>(value < 0 ? static_cast<int64_t>(vertexCount) + value : value - 1);
+        }
+
+        int64_t readReference(const char* objfile) {
+            if (it == end || *it == '/' || isSpace(*it))
+                return 0;
+
+            int64_t value = 0;
+            auto [ptr, ec] = from_chars(it, end, value);
+            if (ec != errc())
+                throw string("Malformed face in ") + objfile;
+            it = ptr;
+            return value;
+        }
+    };
+}
+
+namespace {
+    // The records of one run of whole lines. Relative face indices can only be resolved once
+    // we know how many vertices came before the run, so we note which corners hold them.
+    struct OBJChunk {
+        MeshData mesh;
+        vector<size_t> relativeCorners;
+        OBJAttributes attributes;
+    };
+}
+
+template <class Sink>
+static void parseOBJLines(const char* it, const char* const end, Sink& sink, const char* objfile) {
+    while (it != end) {
+        const char *eol = it;
+        while (eol != end && *eol != '\n')
+            ++eol;
+
+        LineParser line{ it, eol };
+        line.skipSpace();
+        if (line.it + 1 < line.end && line.isSpace(line.it[1])) {
+            if (line.it[0] == 'v') {
+                // Process vertices
+                ++line.it;
+                f32v3 p;
+                p.x = line.readFloat(objfile);
+                p.y = line.readFloat(objfile);
+                p.z = line.readFloat(objfile);
+
+                sink.vertex(p);
+            } else if (line.it[0] == 'f') {
+                // Process faces
+                ++line.it;
+                while (!line.atEnd()) {
+                    const bool relative = *line.it == '-';
+                    int64_t uv, normal;
+                    sink.corner(line.readCorner(sink.vertexCount(), uv, normal, objfile), relative);
+                    sink.cornerAttributes(uv, normal);
+                }
+
+                sink.endFace();
+            }
+        } else if (line.it + 2 < line.end && line.it[0] == 'v' && line.isSpace(line.it[2])) {
+            if (line.it[1] == 'n') {
+                line.it += 2;
+                f32v3 n;
+                n.x = line.readFloat(objfile);
+                n.y = line.readFloat(objfile);
+                n.z = line.readFloat(objfile);
+
+                sink.normal(n);
+            } else if (line.it[1] == 't') {
+                // A second coordinate is optional, and a third is no use to us
+                line.it += 2;
+                f32v2 t;
+                t.x = line.readFloat(objfile);
+                t.y = line.atEnd() ? 0.0f : line.readFloat(objfile);
+
+                sink.uv(t);
+            }
+        }
+
+        it = eol == end ? end : eol + 1;
+    }
+}
+
+static MeshData readOBJMapped(const char* objfile) {
+    const MappedFile file(objfile);
+    MeshData mesh;
+    OBJAttributes attributes;
+    MeshDataSink sink{ mesh, nullptr, &attributes };
+
+    // A single run starts at the first vertex, so relative indices are already resolved
+    parseOBJLines(file.data(), file.data() + file.size(), sink, objfile);
+
+    settleAttributes(mesh, attributes);
+    return mesh;
+}
+
+static MeshData readOBJParallel(const char* objfile) {
+    // Below this there is more to lose starting threads than to gain from them
+    constexpr size_t minimumChunk = 1ul << 20ul;
+
+    const MappedFile file(objfile);
+    const char *const begin = file.data(), *const end = begin + file.size();
+    const size_t chunkCount = max<size_t>(1ul, min<size_t>(hardwareThreads(), file.size() / minimumChunk));
+
+    // Cut the file into roughly equal runs, each ending on a line break
+    vector<const char*> cuts{ begin };
+    for (size_t i = 1ul; i < chunkCount; ++i) {
+        const char *cut = max(cuts.back(), begin + file.size() * i / chunkCount);
+        while (cut != end && *cut++ != '\n');
+        cuts.push_back(cut);
+    }
+    cuts.push_back(end);
+
+    vector<OBJChunk> chunks(chunkCount);
+    vector<string> errors(chunkCount);
+    parallelFor(chunkCount, [&](size_t i) {
+        try {
+            MeshDataSink sink{ chunks[i].mesh, &chunks[i].relativeCorners, &chunks[i].attributes };
+            parseOBJLines(cuts[i], cuts[i + 1], sink, objfile);
+        } catch (const string& error) {
+            errors[i] = error;
+        }
+    });
+
+    for (const string &error : errors)
+        if (!error.empty())
+            throw error;
+
+    // Lay the chunks out back to back, in file order, exactly as a single run would have
+    vector<size_t> vertexBase{ 0ul }, cornerBase{ 0ul }, faceBase{ 0ul };
+    vector<size_t> normalBase{ 0ul }, uvBase{ 0ul }, normalPickBase{ 0ul }, uvPickBase{ 0ul };
+    for (const OBJChunk &chunk : chunks) {
+        vertexBase.push_back(vertexBase.back() + chunk.mesh.positions.size());
+        cornerBase.push_back(cornerBase.back() + chunk.mesh.indices.size());
+        faceBase.push_back(faceBase.back() + chunk.mesh.faceCount());
+        normalBase.push_back(normalBase.back() + chunk.attributes.normals.size());
+        uvBase.push_back(uvBase.back() + chunk.attributes.uvs.size());
+        normalPickBase.push_back(normalPickBase.back() + chunk.attributes.normalPicks.size());
+        uvPickBase.push_back(uvPickBase.back() + chunk.attributes.uvPicks.size());
+    }
+
+    MeshData mesh;
+    mesh.positions.resize(vertexBase.back());
+    mesh.indices.resize(cornerBase.back());
+    mesh.faceStarts.resize(faceBase.back() + 1ul);
+
+    OBJAttributes attributes;
+    attributes.normals.resize(normalBase.back());
+    attributes.uvs.resize(uvBase.back());
+    attributes.normalPicks.resize(normalPickBase.back());
+    attributes.uvPicks.resize(uvPickBase.back());
+
+    parallelFor(chunkCount, [&](size_t i) {
+        const MeshData &part = chunks[i].mesh;
+        copy(part.positions.begin(), part.positions.end(), mesh.positions.begin() + vertexBase[i]);
+        copy(part.indices.begin(), part.indices.end(), mesh.indices.begin() + cornerBase[i]);
+        for (size_t face = 1ul; face <= part.faceCount(); ++face)
+            mesh.faceStarts[faceBase[i] + face] = static_cast<uint32_t>(cornerBase[i] + part.faceStarts[face]);
+
+        // Relative indices were resolved against the chunk's own vertices, wrapping around if they reached further back
+        for (size_t corner : chunks[i].relativeCorners)
+            mesh.indices[cornerBase[i] + corner] += static_cast<uint32_t>(vertexBase[i]);
+
+        // The same goes for the picks of normals and texture coordinates, which move with their corners too
+        const OBJAttributes &own = chunks[i].attributes;
+        copy(own.normals.begin(), own.normals.end(), attributes.normals.begin() + normalBase[i]);
+        copy(own.uvs.begin(), own.uvs.end(), attributes.uvs.begin() + uvBase[i]);
+        for (size_t pick = 0ul; pick < own.normalPicks.size(); ++pick)
+            attributes.normalPicks[normalPickBase[i] + pick] = { cornerBase[i] + own.normalPicks[pick].corner, own.normalPicks[pick].index };
+        for (size_t pick = 0ul; pick < own.uvPicks.size(); ++pick)
+            attributes.uvPicks[uvPickBase[i] + pick] = { cornerBase[i] + own.uvPicks[pick].corner, own.uvPicks[pick].index };
+        for (size_t pick : own.relativeNormalPicks)
+            attributes.normalPicks[normalPickBase[i] + pick].index += static_cast<uint32_t>(normalBase[i]);
+        for (size_t pick : own.relativeUVPicks)
+            attributes.uvPicks[uvPickBase[i] + pick].index += static_cast<uint32_t>(uvBase[i]);
+    });
+
+    settleAttributes(mesh, attributes);
+    return mesh;
+}
+
+
+/////////
+// OBJ //
+/////////
+MeshData readOBJ(const char* objfile, LoadMode mode) {
+    switch (mode) {
+    case LoadMode::Stream:
+        return readOBJStream(objfile);
+    case LoadMode::Mapped:
+        return readOBJMapped(objfile);
+    case LoadMode::Parallel:
+    default:
+        return readOBJParallel(objfile);
+    }
+}
+
+
+/////////
+// PLY //
+/////////
+namespace {
+    enum class PLYType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    struct PLYProperty {
+        string name;
+        PLYType type;
+        bool isList;
+        PLYType countType;
+    };
+
+    struct PLYElement {
+        string name;
+        size_t count;
+        vector<PLYProperty> properties;
+    };
+
+    size_t sizeOf(PLYType type) {
+        constexpr size_t sizes[] = { 1ul, 1ul, 2ul, 2ul, 4ul, 4ul, 4ul, 8ul };
+        return sizes[static_cast<size_t>(type)];
+    }
+
+    PLYType parsePLYType(const string& name, const char* plyfile) {
+        static const pair<const char*, PLYType> names[] = {
+            { "char", PLYType::Int8 },     { "int8", PLYType::Int8 },
+            { "uchar", PLYType::UInt8 },   { "uint8", PLYType::UInt8 },
+            { "short", PLYType::Int16 },   { "int16", PLYType::Int16 },
+            { "ushort", PLYType::UInt16 }, { "uint16", PLYType::UInt16 },
+            { "int", PLYType::Int32 },     { "int32", PLYType::Int32 },
+            { "uint", PLYType::UInt32 },   { "uint32", PLYType::UInt32 },
+            { "float", PLYType::Float32 }, { "float32", PLYType::Float32 },
+            { "double", PLYType::Float64 }, { "float64", PLYType::Float64 },
+        };
+        for (const auto &[text, type] : names)
+            if (name == text)
+                return type;
+        throw string("Unknown PLY property type ") + name + " in " + plyfile;
+    }
+
+    // Pulls fixed size binary values off the mapped body in the file's byte order
+    struct BinaryCursor {
+        const char *it, *end;
+        bool swap;
+        const char *file;
+
+        void need(size_t bytes) const {
+            if (static_cast<size_t>(end - it) < bytes)
+                throw string("Unexpected end of ") + file;
+        }
+
+        // Reads a value at a given spot without moving, bounds are the caller's problem
+        template <class T>
+        T peek(const char* at) const {
+            using Bits = conditional_t<sizeof(T) == 8ul, uint64_t, conditional_t<sizeof(T) == 4ul, uint32_t, uint16_t>>;
+
+            T value;
+            memcpy(&value, at, sizeof(T));
+            if constexpr (sizeof(T) > 1ul)
+                if (swap)
+                    value = bit_cast<T>(byteswap(bit_cast<Bits>(value)));
+            return value;
+        }
+
+        template <class T>
+        T read() {
+            need(sizeof(T));
+            const T value = peek<T>(it);
+            it += sizeof(T);
+            return value;
+        }
+
+        double read(PLYType type) {
+            switch (type) {
+            case PLYType::Int8:    return read<int8_t>();
+            case PLYType::UInt8:   return read<uint8_t>();
+            case PLYType::Int16:   return read<int16_t>();
+            case PLYType::UInt16:  return read<uint16_t>();
+            case PLYType::Int32:   return read<int32_t>();
+            case PLYType::UInt32:  return read<uint32_t>();
+            case PLYType::Float32: return read<float>();
+            case PLYType::Float64:
+            default:               return read<double>();
+            }
+        }
+
+        void skip(const PLYProperty& property) {
+            size_t count = 1ul;
+            if (property.isList)
+                count = static_cast<size_t>(read(property.countType));
+            need(count * sizeOf(property.type));
+            it += count * sizeOf(property.type);
+        }
+    };
+}
+
+template <class Sink>
+static void parsePLY(const char* plyfile, Sink& sink) {
+    const MappedFile file(plyfile);
+    const string_view text = file.view();
+
+    // The header is text, one line at a time up to end_header
+    vector<PLYElement> elements;
+    bool bigEndian = false;
+    size_t bodyStart = string_view::npos;
+    for (size_t line = 0ul; line < text.size();) {
+        size_t eol = text.find('\n', line);
+        if (eol == string_view::npos)
+            eol = text.size();
+
+        istringstream words(string(text.substr(line, eol - line)));
+        string keyword;
+        words >> keyword;
+        line = eol + 1ul;
+
+        if (keyword == "ply" || keyword == "comment" || keyword == "obj_info" || keyword.empty()) {
+            continue;
+        } else if (keyword == "format") {
+            string format;
+            words >> format;
+            if (format == "binary_big_endian")
+                bigEndian = true;
+            else if (format != "binary_little_endian")
+                throw string("Only binary PLY files are supported, ") + plyfile + " is " + format;
+        } else if (keyword == "element") {
+            PLYElement element{};
+            words >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property") {
+            if (elements.empty())
+                throw string("PLY property outside of an element in ") + plyfile;
+
+            PLYProperty property{};
+            string type;
+            words >> type;
+            if (type == "list") {
+                string countType;
+                words >> countType >> type;
+                property.isList = true;
+                property.countType = parsePLYType(countType, plyfile);
+            }
+            property.type = parsePLYType(type, plyfile);
+            words >> property.name;
+            elements.back().properties.push_back(property);
+        } else if (keyword == "end_header") {
+            bodyStart = line;
+            break;
+        }
+    }
+
+    if (bodyStart == string_view::npos || text.substr(0, 3) != "ply")
+        throw string("Malformed PLY header in ") + plyfile;
+
+    // Every record takes at least its fixed properties and list counts, so no count can be larger than what the
+    // rest of the file holds at that size. Checked before any count is multiplied out or reserved for.
+    size_t remaining = file.size() - bodyStart;
+    for (const PLYElement &element : elements) {
+        size_t smallest = 0ul;
+        for (const PLYProperty &property : element.properties)
+            smallest += sizeOf(property.isList ? property.countType : property.type);
+        if (element.count > remaining / max(1ul, smallest))
+            throw string("PLY ") + element.name + " count is larger than " + plyfile + " can hold";
+        remaining -= element.count * smallest;
+    }
+
+    BinaryCursor body{ file.data() + bodyStart, file.data() + file.size(), bigEndian != (endian::native == endian::big), plyfile };
+    for (const PLYElement &element : elements) {
+        if (element.name == "vertex")
+            sink.reserve(element.count, 0ul);
+        else if (element.name == "face")
+            sink.reserve(0ul, element.count);
+    }
+
+    for (const PLYElement &element : elements) {
+        if (element.name == "vertex") {
+            // Find where the position, and the normal and texture coordinates if there are any, sit among the
+            // vertex's properties. Texture coordinates go by a few names.
+            static const vector<const char*> channelNames[] = {
+                { "x" }, { "y" }, { "z" }, { "nx" }, { "ny" }, { "nz" }, { "u", "s", "texture_u" }, { "v", "t", "texture_v" }
+            };
+            constexpr size_t channelCount = size(channelNames);
+
+            int channels[channelCount];
+            fill(begin(channels), end(channels), -1);
+            vector<int> channelOf(element.properties.size(), -1);
+            bool fixedStride = true;
+            size_t stride = 0ul, offsets[channelCount] = {};
+            for (size_t i = 0ul; i < element.properties.size(); ++i) {
+                const PLYProperty &property = element.properties[i];
+                for (size_t channel = 0ul; channel < channelCount; ++channel) {
+                    for (const char *name : channelNames[channel]) {
+                        if (property.name == name && !property.isList) {
+                            channels[channel] = static_cast<int>(i);
+                            channelOf[i] = static_cast<int>(channel);
+                            offsets[channel] = stride;
+                        }
+                    }
+                }
+                fixedStride &= !property.isList;
+                stride += sizeOf(property.type);
+            }
+            if (channels[0] < 0 || channels[1] < 0 || channels[2] < 0)
+                throw string("PLY vertices are missing a coordinate in ") + plyfile;
+
+            const bool hasNormals = channels[3] >= 0 && channels[4] >= 0 && channels[5] >= 0;
+            const bool hasUVs = channels[6] >= 0 && channels[7] >= 0;
+            const size_t used = hasUVs ? 8ul : hasNormals ? 6ul : 3ul;
+            auto emit = [&](const float (&values)[channelCount]) {
+                sink.vertex({ values[0], values[1], values[2] });
+                if (hasNormals)
+                    sink.vertexNormal({ values[3], values[4], values[5] });
+                if (hasUVs)
+                    sink.vertexUV({ values[6], values[7] });
+            };
+
+            bool allFloats = true;
+            for (size_t channel = 0ul; channel < used; ++channel)
+                allFloats &= channels[channel] < 0 || element.properties[channels[channel]].type == PLYType::Float32;
+
+            float values[channelCount] = {};
+            if (fixedStride && allFloats) {
+                // Common case, plain floats at a fixed stride
+                body.need(element.count * stride);
+                for (size_t i = 0ul; i < element.count; ++i) {
+                    for (size_t channel = 0ul; channel < used; ++channel)
+                        if (channels[channel] >= 0)
+                            values[channel] = body.peek<float>(body.it + offsets[channel]);
+                    emit(values);
+                    body.it += stride;
+                }
+            } else {
+                for (size_t vertex = 0ul; vertex < element.count; ++vertex) {
+                    for (size_t i = 0ul; i < element.properties.size(); ++i) {
+                        const PLYProperty &property = element.properties[i];
+                        if (channelOf[i] >= 0)
+                            values[channelOf[i]] = static_cast<float>(body.read(property.type));
+                        else
+                            body.skip(property);
+                    }
+                    emit(values);
+                }
+            }
+        } else if (element.name == "face") {
+            for (size_t face = 0ul; face < element.count; ++face) {
+                for (const PLYProperty &property : element.properties) {
+                    if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                        const size_t degree = static_cast<size_t>(body.read(property.countType));
+                        for (size_t corner = 0ul; corner < degree; ++corner)
+                            sink.corner(static_cast<uint32_t>(body.read(property.type)), false);
+                        sink.endFace();
+                    } else {
+                        body.skip(property);
+                    }
+                }
+            }
+        } else {
+            // Edges, materials and whatever else have nothing for us
+            for (size_t i = 0ul; i < element.count; ++i)
+                for (const PLYProperty &property : element.properties)
+                    body.skip(property);
+        }
+    }
+}
+
+MeshData readPLY(const char* plyfile) {
+    MeshData mesh;
+    MeshDataSink sink{ mesh };
+    parsePLY(plyfile, sink);
+    return mesh;
+}
+
+
+/////////
+// STL //
+/////////
+template <class Sink>
+static void parseSTL(const char* stlfile, Sink& sink) {
+    constexpr size_t headerSize = 80ul + sizeof(uint32_t), triangleSize = 50ul;
+
+    const MappedFile file(stlfile);
+    if (file.size() < headerSize)
+        throw string("Malformed STL file ") + stlfile;
+
+    uint32_t triangles;
+    memcpy(&triangles, file.data() + 80ul, sizeof(triangles));
+    if (endian::native == endian::big)
+        triangles = byteswap(triangles);
+    if (file.size() != headerSize + triangles * triangleSize)
+        throw string("Only binary STL files are supported, ") + stlfile + " is not one";
+
+    sink.reserve(triangles / 2ul, triangles);
+    uint32_t vertices = 0u;
+
+    // Every corner could in principle be unique, the table is sized so that never overfills it
+    FlatHashMap<PositionKey, uint32_t, PositionHash> welded(triangles * 3ul / 2ul, { ~0u, ~0u, ~0u });
+
+    BinaryCursor body{ file.data() + headerSize, file.data() + file.size(), endian::native == endian::big, stlfile };
+    for (uint32_t triangle = 0u; triangle < triangles; ++triangle) {
+        // Skip the facet normal, we derive our own
+        body.it += 3ul * sizeof(float);
+
+        uint32_t corners[3];
+        for (uint32_t &corner : corners) {
+            const f32v3 p = { body.read<float>(), body.read<float>(), body.read<float>() };
+            auto [index, inserted] = welded.tryEmplace(PositionKey::of(p), vertices);
+            if (inserted) {
+                sink.vertex(p);
+                ++vertices;
+            }
+            corner = *index;
+        }
+
+        // Attribute byte count
+        body.it += sizeof(uint16_t);
+
+        // Welding can pinch slivers down to nothing
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+            continue;
+
+        for (uint32_t corner : corners)
+            sink.corner(corner, false);
+        sink.endFace();
+    }
+}
+
+MeshData readSTL(const char* stlfile) {
+    MeshData mesh;
+    MeshDataSink sink{ mesh };
+    parseSTL(stlfile, sink);
+    return mesh;
+}
+
+
+//////////
+// Mesh //
+//////////
+static string extensionOf(const char* meshfile) {
+    string extension = filesystem::path(meshfile).extension().string();
+    transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return tolower(c); });
+    return extension;
+}
+
+MeshData readMesh(const char* meshfile, LoadMode mode) {
+    const string extension = extensionOf(meshfile);
+    if (extension == ".ply")
+        return readPLY(meshfile);
+    if (extension == ".stl")
+        return readSTL(meshfile);
+    return readOBJ(meshfile, mode);
+}
+
+void streamMesh(const char* meshfile, MeshStream& stream) {
+    StreamSink sink{ stream, {}, 0ul };
+
+    const string extension = extensionOf(meshfile);
+    if (extension == ".ply") {
+        parsePLY(meshfile, sink);
+    } else if (extension == ".stl") {
+        parseSTL(meshfile, sink);
+    } else {
+        const MappedFile file(meshfile);
+        parseOBJLines(file.data(), file.data() + file.size(), sink, meshfile);
+    }
+}
+
+
+/////////////
+// Writing //
+/////////////
+void writeOBJ(const char* objfile, const MeshData& mesh) {
+    ofstream file(objfile);
+    if (!file.is_open())
+        throw string("Could not open file ") + objfile + " for writing";
+
+    // Plenty for a float to survive the round trip
+    file.precision(9);
+    for (const f32v3 &p : mesh.positions)
+        file << "v " << p << '\n';
+    for (const f32v3 &n : mesh.normals)
+        file << "vn " << n << '\n';
+    for (const f32v2 &t : mesh.uvs)
+        file << "vt " << t << '\n';
+
+    // Attributes are per vertex, so every corner picks the ones numbered the same as its vertex
+    const bool normals = !mesh.normals.empty(), uvs = !mesh.uvs.empty();
+    for (size_t face = 0ul; face < mesh.faceCount(); ++face) {
+        file << 'f';
+        for (uint32_t corner = mesh.faceStarts[face]; corner < mesh.faceStarts[face + 1]; ++corner) {
+            const uint32_t index = mesh.indices[corner] + 1u;
+            file << ' ' << index;
+            if (uvs || normals) {
+                file << '/';
+                if (uvs)
+                    file << index;
+                if (normals)
+                    file << '/' << index;
+            }
+        }
+        file << '\n';
+    }
+
+    if (!file)
+        throw string("Could not write ") + objfile;
+}
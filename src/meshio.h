@@ -0,0 +1,49 @@
+#pragma once
+
+#include "simd.h"
+
+#include <cstdint> // uint32_t
+#include <vector>  // vector
+
+
+// Polygon soup, the common currency between file readers and the halfedge builder
+struct MeshData {
+    std::vector<f32v3> positions;
+    std::vector<uint32_t> indices;    // Corners of every face back to back, zero based
+    std::vector<uint32_t> faceStarts; // Offset of each face's first corner, plus one past the last
+
+    // Optional, each either empty or one per position. OBJ gives them per corner instead, so a vertex takes the
+    // average of its corners' normals and the texture coordinates of its first corner, one side of any seam.
+    std::vector<f32v3> normals;
+    std::vector<f32v2> uvs;
+
+    MeshData(): faceStarts{ 0u } {}
+
+    size_t faceCount() const { return faceStarts.size() - 1ul; }
+};
+
+enum class LoadMode {
+    Stream,   // Token by token through an ifstream
+    Mapped,   // Parsed in place out of a memory mapped file
+    Parallel, // Mapped, with line aligned chunks parsed concurrently on every core
+};
+
+MeshData readOBJ(const char* objfile, LoadMode mode = LoadMode::Parallel);
+MeshData readPLY(const char* plyfile);
+MeshData readSTL(const char* stlfile);
+
+// Picks the reader from the file extension, anything unrecognized is read as OBJ
+MeshData readMesh(const char* meshfile, LoadMode mode = LoadMode::Parallel);
+
+// Receives a mesh one record at a time, for callers that can't hold all of it at once
+class MeshStream {
+public:
+    virtual ~MeshStream() = default;
+
+    virtual void vertex(const f32v3& p) = 0;
+    virtual void face(const uint32_t* corners, size_t degree) = 0;
+};
+
+void streamMesh(const char* meshfile, MeshStream& stream);
+
+void writeOBJ(const char* objfile, const MeshData& mesh);
@@ -0,0 +1,571 @@
+#include "outofcore.h"
+#include "collapsible.h"
+#include "flathash.h"
+#include "mappedfile.h"
+
+#include <algorithm>  // any_of, binary_search, count_if, for_each, max, min, sort, unique
+#include <atomic>     // atomic
+#include <filesystem> // path, temp_directory_path, create_directories, remove, remove_all
+#include <fstream>    // ifstream, ofstream
+#include <functional> // greater
+#include <limits>     // numeric_limits
+#include <queue>      // priority_queue
+#include <span>       // span
+#include <string>     // string, to_string
+#include <unistd.h>   // getpid
+#include <utility>    // pair
+#include <vector>     // vector
+
+using namespace std;
+
+
+// Rough footprint of one face once built into a Collapsible, with its share of the vertices,
+// edges and halfedges plus the soup and scratch tables it was built from. Every face brings
+// about two QEFs with it, one on its share of the vertices and one on its share of the edges,
+// and the plane metric keeps the face's plane besides.
+static constexpr size_t bytesPerFace = 384ul;
+
+static size_t faceFootprint(ErrorMetric metric) {
+    return bytesPerFace + (metric == ErrorMetric::Plane ? 2ul * (sizeof(PlaneQEF) - sizeof(DistanceQEF)) + sizeof(FacePlane) : 0ul);
+}
+
+// One open file per slab while bucketing, keep well clear of descriptor limits
+static constexpr size_t maximumSlabs = 512ul;
+
+static constexpr uint32_t unlocked = numeric_limits<uint32_t>::max();
+
+
+namespace {
+    atomic<uint64_t> calls = 0ul;
+
+    // Removes the scratch directory however we leave. Named for the process and the call, as calls can run side by side.
+    struct ScratchDirectory {
+        filesystem::path path;
+
+        ScratchDirectory(const char* parent)
+          : path(filesystem::path(parent ? parent : filesystem::temp_directory_path().c_str())
+                 / ("simplify-" + to_string(getpid()) + "-" + to_string(calls++))) {
+            filesystem::create_directories(path);
+        }
+        ~ScratchDirectory() {
+            error_code ignored;
+            filesystem::remove_all(path, ignored);
+        }
+    };
+
+    template <class T>
+    void writeValue(ofstream& file, const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <class T>
+    bool readValue(ifstream& file, T& value) {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    template <class T>
+    void writeVector(ofstream& file, const vector<T>& values) {
+        writeValue(file, values.size());
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    template <class T>
+    void readVector(ifstream& file, vector<T>& values) {
+        size_t count = 0ul;
+        readValue(file, count);
+        values.resize(count);
+        file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    }
+
+    // Faces are spooled as their degree followed by their global vertex indices
+    bool readFace(ifstream& file, vector<uint32_t>& corners) {
+        uint32_t degree = 0u;
+        if (!readValue(file, degree))
+            return false;
+        corners.resize(degree);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(corners.data()), degree * sizeof(uint32_t)));
+    }
+
+    void writeFace(ofstream& file, const vector<uint32_t>& corners) {
+        writeValue(file, static_cast<uint32_t>(corners.size()));
+        file.write(reinterpret_cast<const char*>(corners.data()), corners.size() * sizeof(uint32_t));
+    }
+
+    // A mesh laid out flat on disk, positions in one file and faces in the other
+    struct Spool {
+        filesystem::path positionsPath, facesPath;
+        f32v3 lo, hi;
+        size_t vertexCount, faceCount;
+
+        void remove() const {
+            filesystem::remove(positionsPath);
+            filesystem::remove(facesPath);
+        }
+    };
+
+    // Positions and faces straight out to disk as they stream past, from the input or from stitching slabs together
+    class Spooler : public MeshStream {
+    public:
+        Spooler(const filesystem::path& positions, const filesystem::path& faces)
+          : m_positions(positions, ios::binary)
+          , m_faces(faces, ios::binary)
+          , m_spool{ positions, faces,
+                     { numeric_limits<float>::max(), numeric_limits<float>::max(), numeric_limits<float>::max() },
+                     { -numeric_limits<float>::max(), -numeric_limits<float>::max(), -numeric_limits<float>::max() },
+                     0ul, 0ul } {
+        }
+
+        void vertex(const f32v3& p) override {
+            writeValue(m_positions, p);
+            m_spool.lo = { min(m_spool.lo.x, p.x), min(m_spool.lo.y, p.y), min(m_spool.lo.z, p.z) };
+            m_spool.hi = { max(m_spool.hi.x, p.x), max(m_spool.hi.y, p.y), max(m_spool.hi.z, p.z) };
+            ++m_spool.vertexCount;
+        }
+
+        void face(const uint32_t* corners, size_t degree) override {
+            // Points and lines have no place in a manifold
+            if (degree < 3ul)
+                return;
+            writeValue(m_faces, static_cast<uint32_t>(degree));
+            m_faces.write(reinterpret_cast<const char*>(corners), degree * sizeof(uint32_t));
+            ++m_spool.faceCount;
+        }
+
+        Spool close() {
+            m_positions.close();
+            m_faces.close();
+            if (!m_positions || !m_faces)
+                throw string("Could not write out of core scratch files");
+            return m_spool;
+        }
+
+    private:
+        ofstream m_positions, m_faces;
+        Spool m_spool;
+    };
+
+    // The simplified remains of one slab, locked vertices remember their global index
+    struct SlabResult {
+        MeshData mesh;
+        vector<uint32_t> globals;
+
+        void write(const filesystem::path& path) const {
+            ofstream file(path, ios::binary);
+            writeVector(file, mesh.positions);
+            writeVector(file, mesh.indices);
+            writeVector(file, mesh.faceStarts);
+            writeVector(file, globals);
+            if (!file)
+                throw string("Could not write ") + path.string();
+        }
+
+        void read(const filesystem::path& path) {
+            ifstream file(path, ios::binary);
+            readVector(file, mesh.positions);
+            readVector(file, mesh.indices);
+            readVector(file, mesh.faceStarts);
+            readVector(file, globals);
+            if (!file)
+                throw string("Could not read ") + path.string();
+        }
+    };
+}
+
+
+// Simplifies one slab with its seams locked. Open edges are closed off with a fan of cap triangles
+// around one extra vertex so the halfedge mesh has no holes, the caps are all locked and stripped off again.
+static SlabResult simplifySlab(const filesystem::path& bucket, const MappedFile& positions,
+                               span<const uint32_t> shared, uint64_t share, ErrorMetric metric) {
+    MeshData mesh;
+    vector<bool> locked;
+    vector<uint32_t> globals;
+
+    ifstream file(bucket, ios::binary);
+    vector<uint32_t> corners;
+    vector<vector<uint32_t>> faces;
+    size_t cornerCount = 0ul;
+    while (readFace(file, corners)) {
+        cornerCount += corners.size();
+        faces.push_back(corners);
+    }
+
+    // Renumber the slab's vertices in order of first use
+    FlatHashMap<uint64_t, uint32_t> local(cornerCount / 2ul, ~0ull);
+    const f32v3 *sourcePositions = reinterpret_cast<const f32v3*>(positions.data());
+    for (const auto &face : faces) {
+        for (uint32_t global : face) {
+            auto [index, inserted] = local.tryEmplace(global, static_cast<uint32_t>(mesh.positions.size()));
+            if (inserted) {
+                mesh.positions.push_back(sourcePositions[global]);
+                locked.push_back(binary_search(shared.begin(), shared.end(), global));
+                globals.push_back(global);
+            }
+            mesh.indices.push_back(*index);
+        }
+        mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+    }
+    faces.clear();
+    faces.shrink_to_fit();
+
+    // Which corner follows each corner around its face
+    vector<uint32_t> nextCorner(mesh.indices.size());
+    for (size_t face = 0ul; face < mesh.faceCount(); ++face)
+        for (uint32_t corner = mesh.faceStarts[face]; corner < mesh.faceStarts[face + 1]; ++corner)
+            nextCorner[corner] = corner + 1 < mesh.faceStarts[face + 1] ? corner + 1 : mesh.faceStarts[face];
+
+    // Count how many faces use each edge and remember the first corner that did, anything used once is open
+    struct EdgeUse {
+        uint32_t count, corner;
+    };
+    auto edgeKey = [&](uint32_t corner) {
+        const uint32_t a = mesh.indices[corner], b = mesh.indices[nextCorner[corner]];
+        return uint64_t(max(a, b)) << 32u | min(a, b);
+    };
+    auto countEdges = [&] {
+        FlatHashMap<uint64_t, EdgeUse> edgeUse(mesh.indices.size() / 2ul, ~0ull);
+        for (uint32_t corner = 0u; corner < mesh.indices.size(); ++corner)
+            ++edgeUse.tryEmplace(edgeKey(corner), { 0u, corner }).first->count;
+        return edgeUse;
+    };
+
+    // Cutting a slab out can leave a vertex with several separate fans of faces around it, each needs
+    // its own copy of the vertex to be a manifold. Corners sharing a closed edge are in the same fan.
+    {
+        vector<uint32_t> fan(mesh.indices.size());
+        for (uint32_t corner = 0u; corner < fan.size(); ++corner)
+            fan[corner] = corner;
+        auto find = [&](uint32_t corner) {
+            while (fan[corner] != corner)
+                corner = fan[corner] = fan[fan[corner]];
+            return corner;
+        };
+        auto join = [&](uint32_t a, uint32_t b) { fan[find(a)] = find(b); };
+
+        FlatHashMap<uint64_t, EdgeUse> edgeUse = countEdges();
+        for (uint32_t corner = 0u; corner < mesh.indices.size(); ++corner) {
+            const EdgeUse &use = *edgeUse.find(edgeKey(corner));
+            if (use.count != 2u || use.corner == corner)
+                continue;
+
+            // Pair up the corners at each end of the edge, whichever way round the other face has it
+            const uint32_t other = use.corner, otherNext = nextCorner[other];
+            const bool flipped = mesh.indices[other] != mesh.indices[corner];
+            join(corner, flipped ? otherNext : other);
+            join(nextCorner[corner], flipped ? other : otherNext);
+        }
+
+        // The first fan found around a vertex keeps it, the rest get locked copies
+        vector<uint32_t> firstFan(mesh.positions.size(), ~0u);
+        FlatHashMap<uint64_t, uint32_t> copies(mesh.indices.size() / 2ul, ~0ull);
+        vector<bool> split(mesh.positions.size(), false);
+        for (uint32_t corner = 0u; corner < mesh.indices.size(); ++corner) {
+            const uint32_t vertex = mesh.indices[corner], root = find(corner);
+            if (firstFan[vertex] == ~0u)
+                firstFan[vertex] = root;
+            if (firstFan[vertex] == root)
+                continue;
+
+            auto [copy, inserted] = copies.tryEmplace(root, static_cast<uint32_t>(mesh.positions.size()));
+            if (inserted) {
+                mesh.positions.push_back(mesh.positions[vertex]);
+                globals.push_back(globals[vertex]);
+                locked.push_back(true);
+                locked[vertex] = true;
+            }
+            mesh.indices[corner] = *copy;
+            split[vertex] = true;
+        }
+
+        // Collapsing neighbours of two copies together would leave one vertex next to both, and welding the copies back
+        // together would give that edge four faces. Every face around a split vertex is locked whole so none ever changes.
+        split.resize(mesh.positions.size(), true);
+        for (size_t face = 0ul; face < mesh.faceCount(); ++face) {
+            const auto begin = mesh.indices.begin() + mesh.faceStarts[face], end = mesh.indices.begin() + mesh.faceStarts[face + 1];
+            if (any_of(begin, end, [&](uint32_t vertex) { return split[vertex]; }))
+                for_each(begin, end, [&](uint32_t vertex) { locked[vertex] = true; });
+        }
+    }
+
+    // Close every open edge off against the apex
+    FlatHashMap<uint64_t, EdgeUse> edgeUse = countEdges();
+    const uint32_t apex = static_cast<uint32_t>(mesh.positions.size());
+    const size_t originalFaces = mesh.faceCount();
+    const uint32_t originalCorners = static_cast<uint32_t>(mesh.indices.size());
+    for (uint32_t corner = 0u; corner < originalCorners; ++corner) {
+        if (edgeUse.find(edgeKey(corner))->count == 1u) {
+            const uint32_t a = mesh.indices[corner], b = mesh.indices[nextCorner[corner]];
+            mesh.indices.insert(mesh.indices.end(), { b, a, apex });
+            mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+            locked[a] = locked[b] = true;
+        }
+    }
+
+    const size_t capFaces = mesh.faceCount() - originalFaces;
+    if (capFaces) {
+        mesh.positions.push_back(mesh.positions.front());
+        locked.push_back(true);
+    }
+
+    // Locked vertices never move and keep their order, so the nth one left is still the nth one we made
+    vector<uint32_t> lockedGlobals;
+    for (size_t i = 0ul; i < globals.size(); ++i)
+        if (locked[i])
+            lockedGlobals.push_back(globals[i]);
+
+    SlabResult result;
+    withMetric(metric, [&](auto& slab) {
+        mesh = {};
+        slab.lockVertices(locked);
+        if (share < originalFaces)
+            slab.simplify(share + capFaces);
+
+        result.mesh = slab.exportMesh();
+        locked = slab.lockedVertices();
+    }, mesh);
+
+    // Strip the caps back off, they are the last faces and the apex is the last vertex
+    result.mesh.faceStarts.resize(result.mesh.faceStarts.size() - capFaces);
+    result.mesh.indices.resize(result.mesh.faceStarts.back());
+    if (capFaces) {
+        result.mesh.positions.pop_back();
+        locked.pop_back();
+    }
+
+    auto nextLocked = lockedGlobals.begin();
+    result.globals.reserve(locked.size());
+    for (bool isLocked : locked)
+        result.globals.push_back(isLocked ? *nextLocked++ : unlocked);
+
+    return result;
+}
+
+
+// Every vertex more than one slab uses, sorted, merged out of each slab's own sorted list of the vertices it uses
+static void findShared(const filesystem::path& directory, size_t slabCount, const filesystem::path& sharedPath) {
+    vector<ifstream> uses;
+    uses.reserve(slabCount);
+    for (size_t slab = 0ul; slab < slabCount; ++slab)
+        uses.emplace_back(directory / ("uses" + to_string(slab)), ios::binary);
+
+    // Smallest vertex at the front of any list, with the list it came from
+    using Head = pair<uint32_t, size_t>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    auto advance = [&](size_t slab) {
+        if (uint32_t vertex; readValue(uses[slab], vertex))
+            heads.push({ vertex, slab });
+    };
+    for (size_t slab = 0ul; slab < slabCount; ++slab)
+        advance(slab);
+
+    ofstream shared(sharedPath, ios::binary);
+    while (!heads.empty()) {
+        const uint32_t vertex = heads.top().first;
+        size_t count = 0ul;
+        for (; !heads.empty() && heads.top().first == vertex; ++count) {
+            const size_t slab = heads.top().second;
+            heads.pop();
+            advance(slab);
+        }
+        if (count > 1ul)
+            writeValue(shared, vertex);
+    }
+
+    if (shared.close(); !shared)
+        throw string("Could not write out of core scratch files");
+    for (size_t slab = 0ul; slab < slabCount; ++slab)
+        filesystem::remove(directory / ("uses" + to_string(slab)));
+}
+
+// The whole spool as a soup, once it is small enough to hold
+static MeshData readSpool(const Spool& spool) {
+    MeshData mesh;
+    mesh.positions.resize(spool.vertexCount);
+
+    ifstream positions(spool.positionsPath, ios::binary), faces(spool.facesPath, ios::binary);
+    positions.read(reinterpret_cast<char*>(mesh.positions.data()), mesh.positions.size() * sizeof(f32v3));
+    if (!positions)
+        throw string("Could not read out of core scratch files");
+
+    vector<uint32_t> corners;
+    mesh.indices.reserve(spool.faceCount * 3ul);
+    mesh.faceStarts.reserve(spool.faceCount + 1ul);
+    while (readFace(faces, corners)) {
+        for (uint32_t corner : corners)
+            if (corner >= spool.vertexCount)
+                throw string("Face references a missing vertex");
+        mesh.indices.insert(mesh.indices.end(), corners.begin(), corners.end());
+        mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+    }
+    return mesh;
+}
+
+// One round: cuts the spool into slabCount slabs, simplifies each with its seams locked down to its share of roundCount,
+// and stitches the results into next. Odd rounds move every cut half a slab along, so the seams the last round left at
+// full detail fall inside a slab.
+static void simplifySlabs(const Spool& spool, size_t slabCount, unsigned round, const filesystem::path& directory,
+                          uint64_t roundCount, ErrorMetric metric, Spooler& next) {
+    const MappedFile positions(spool.positionsPath.c_str());
+    const f32v3 *points = reinterpret_cast<const f32v3*>(positions.data());
+
+    // Slice along the longest axis
+    const f32v3 extent = spool.hi - spool.lo;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    auto coordinate = [&](const vector<uint32_t>& corners) {
+        float sum = 0.0f;
+        for (uint32_t corner : corners) {
+            if (corner >= spool.vertexCount)
+                throw string("Face references a missing vertex");
+            sum += (&points[corner].x)[axis];
+        }
+        return sum / static_cast<float>(corners.size());
+    };
+
+    // Histogram the faces along the axis so every slab gets about the same share
+    constexpr size_t binCount = 4096ul;
+    const float lo = (&spool.lo.x)[axis], width = max((&extent.x)[axis], numeric_limits<float>::min());
+    auto binOf = [&](float c) { return min(binCount - 1ul, static_cast<size_t>((c - lo) / width * binCount)); };
+
+    vector<size_t> bins(binCount, 0ul);
+    vector<uint32_t> corners;
+    {
+        ifstream faces(spool.facesPath, ios::binary);
+        while (readFace(faces, corners))
+            ++bins[binOf(coordinate(corners))];
+    }
+
+    const size_t shift = round % 2u ? spool.faceCount / 2ul : 0ul, slabs = slabCount + (shift ? 1ul : 0ul);
+    vector<size_t> slabOfBin(binCount);
+    for (size_t bin = 0ul, seen = 0ul; bin < binCount; ++bin) {
+        slabOfBin[bin] = min(slabs - 1ul, (seen * slabCount + shift) / spool.faceCount);
+        seen += bins[bin];
+    }
+
+    // Bucket the faces by slab
+    vector<size_t> slabFaces(slabs, 0ul);
+    {
+        vector<ofstream> buckets;
+        buckets.reserve(slabs);
+        for (size_t slab = 0ul; slab < slabs; ++slab)
+            buckets.emplace_back(directory / ("slab" + to_string(slab)), ios::binary);
+
+        ifstream faces(spool.facesPath, ios::binary);
+        while (readFace(faces, corners)) {
+            const size_t slab = slabOfBin[binOf(coordinate(corners))];
+            writeFace(buckets[slab], corners);
+            ++slabFaces[slab];
+        }
+
+        for (ofstream &bucket : buckets)
+            if (bucket.close(); !bucket)
+                throw string("Could not write out of core scratch files");
+    }
+
+    // Which vertices more than one slab uses, worked out a slab at a time so no table ever covers the whole mesh
+    for (size_t slab = 0ul; slab < slabs; ++slab) {
+        vector<uint32_t> used;
+        ifstream bucket(directory / ("slab" + to_string(slab)), ios::binary);
+        while (readFace(bucket, corners))
+            used.insert(used.end(), corners.begin(), corners.end());
+        sort(used.begin(), used.end());
+        used.erase(unique(used.begin(), used.end()), used.end());
+
+        ofstream uses(directory / ("uses" + to_string(slab)), ios::binary);
+        uses.write(reinterpret_cast<const char*>(used.data()), used.size() * sizeof(uint32_t));
+        if (uses.close(); !uses)
+            throw string("Could not write out of core scratch files");
+    }
+
+    const filesystem::path sharedPath = directory / "shared";
+    findShared(directory, slabs, sharedPath);
+
+    // Simplify each slab to its share of the round's count, one at a time
+    size_t lockedCount = 0ul;
+    {
+        const MappedFile sharedFile(sharedPath.c_str());
+        const span<const uint32_t> shared(reinterpret_cast<const uint32_t*>(sharedFile.data()), sharedFile.size() / sizeof(uint32_t));
+
+        for (size_t slab = 0ul; slab < slabs; ++slab) {
+            const filesystem::path bucket = directory / ("slab" + to_string(slab));
+            const SlabResult result = simplifySlab(bucket, positions, shared, roundCount * slabFaces[slab] / spool.faceCount, metric);
+            lockedCount += static_cast<size_t>(count_if(result.globals.begin(), result.globals.end(), [](uint32_t global) { return global != unlocked; }));
+            result.write(directory / ("result" + to_string(slab)));
+            filesystem::remove(bucket);
+        }
+    }
+    filesystem::remove(sharedPath);
+
+    // Stitch the slabs back together on their locked vertices, straight out to the next spool
+    FlatHashMap<uint64_t, uint32_t> welded(lockedCount + 1ul, ~0ull);
+    uint32_t vertexCount = 0u;
+    for (size_t slab = 0ul; slab < slabs; ++slab) {
+        SlabResult result;
+        result.read(directory / ("result" + to_string(slab)));
+        filesystem::remove(directory / ("result" + to_string(slab)));
+
+        vector<uint32_t> remap(result.mesh.positions.size());
+        for (size_t i = 0ul; i < remap.size(); ++i) {
+            remap[i] = result.globals[i] == unlocked ? vertexCount : *welded.tryEmplace(result.globals[i], vertexCount).first;
+            if (remap[i] == vertexCount) {
+                next.vertex(result.mesh.positions[i]);
+                ++vertexCount;
+            }
+        }
+
+        for (size_t face = 0ul; face < result.mesh.faceCount(); ++face) {
+            corners.assign(result.mesh.indices.begin() + result.mesh.faceStarts[face], result.mesh.indices.begin() + result.mesh.faceStarts[face + 1ul]);
+            for (uint32_t &corner : corners)
+                corner = remap[corner];
+            next.face(corners.data(), corners.size());
+        }
+    }
+}
+
+OutOfCoreStats simplifyOutOfCore(const char* meshfile, const char* objfile, uint64_t finalCount, size_t memoryBudget,
+                                 const char* scratchDirectory, ErrorMetric metric) {
+    if (metric == ErrorMetric::Normal || metric == ErrorMetric::Texture)
+        throw string("Out of core simplification spools positions only, it cannot carry normals or texture coordinates");
+
+    const ScratchDirectory scratch(scratchDirectory);
+    OutOfCoreStats stats = {};
+
+    // Stream the input out to flat scratch files
+    Spooler input(scratch.path / "positions0", scratch.path / "faces0");
+    streamMesh(meshfile, input);
+    Spool spool = input.close();
+    stats.inputFaces = spool.faceCount;
+
+    for (unsigned round = 0u;; ++round) {
+        const size_t slabCount = max<size_t>(1ul, (spool.faceCount * faceFootprint(metric) + memoryBudget - 1ul) / max<size_t>(1ul, memoryBudget));
+        // Shifted rounds cut one slab more. Capping the count instead would have every slab overrun the budget.
+        if (slabCount > maximumSlabs - 1ul)
+            throw string("Memory budget of ") + to_string(memoryBudget) + " bytes is too small for " + to_string(spool.faceCount) + " faces";
+        if (slabCount == 1ul) {
+            // It all fits, finish in core with nothing locked
+            MeshData mesh = readSpool(spool);
+            spool.remove();
+            withMetric(metric, [&](auto& whole) {
+                mesh = {};
+                if (finalCount < whole.faceCount())
+                    whole.simplify(finalCount);
+                stats.outputFaces = whole.faceCount();
+                writeOBJ(objfile, whole.exportMesh());
+            }, mesh);
+            return stats;
+        }
+
+        Spooler stitched(scratch.path / ("positions" + to_string(round + 1u)), scratch.path / ("faces" + to_string(round + 1u)));
+        // Seams stay at full detail through a round, so squeezing a lot out of every slab at once leaves their insides
+        // far coarser than the seams. Halving each round instead lets the next round's cuts catch the old seams up, and
+        // the slabs never go below half of what fits so the final pass, with no seam locked, still has the most to do.
+        const uint64_t roundCount = max<uint64_t>(finalCount, max(memoryBudget / faceFootprint(metric) / 2ul, spool.faceCount / 2ul));
+        simplifySlabs(spool, slabCount, round, scratch.path, roundCount, metric, stitched);
+        spool.remove();
+
+        // Locked seams come through every round at full detail, a round that takes nothing off can only be repeated
+        const size_t previousFaces = spool.faceCount;
+        spool = stitched.close();
+        ++stats.rounds;
+        if (spool.faceCount >= previousFaces)
+            throw string("The seams between slabs alone do not fit in the memory budget");
+    }
+}
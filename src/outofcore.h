@@ -0,0 +1,23 @@
+#pragma once
+
+#include "errorfunction.h"
+
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+
+
+struct OutOfCoreStats {
+    uint64_t inputFaces, outputFaces;
+    unsigned rounds; // Passes over the slabs before what was left fit in memoryBudget, 0 if the input already did
+};
+
+// Simplifies meshfile into objfile without ever holding the whole input in memory. The mesh is cut
+// into slabs along its longest axis, each small enough to build within memoryBudget bytes, and every
+// slab is simplified on its own with the vertices it shares with other slabs locked in place. The
+// simplified slabs are stitched back together on those vertices, on disk. Once that fits within
+// memoryBudget it is simplified once more, seams included, down to finalCount faces; until then it
+// goes round again, cut half a slab further along so the old seams are simplified inside slabs.
+// Intermediate files go in a directory under scratchDirectory, or the system's temporary directory,
+// and are removed afterwards. Every pass measures error with metric, which cannot be one that carries attributes.
+OutOfCoreStats simplifyOutOfCore(const char* meshfile, const char* objfile, uint64_t finalCount, size_t memoryBudget,
+                                 const char* scratchDirectory = nullptr, ErrorMetric metric = ErrorMetric::Distance);
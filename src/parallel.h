@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm> // max, min
+#include <cstddef>   // size_t
+#include <thread>    // thread, jthread
+#include <utility>   // exchange
+#include <vector>    // vector
+
+
+// Lowers hardwareThreads() on the thread that holds it, for as long as it lives. Work that already runs side by side
+// with others, like one mesh of many, takes its share of the cores this way rather than every one of them each.
+class ThreadBudget {
+public:
+    explicit ThreadBudget(unsigned threads) : m_previous(std::exchange(slot(), threads)) {}
+    ~ThreadBudget() { slot() = m_previous; }
+
+    ThreadBudget(const ThreadBudget&) = delete;
+    ThreadBudget& operator=(const ThreadBudget&) = delete;
+
+    // Threads allowed to the calling thread, 0 while it holds no budget
+    static unsigned limit() { return slot(); }
+
+private:
+    static unsigned& slot() {
+        thread_local unsigned threads = 0u;
+        return threads;
+    }
+
+    unsigned m_previous;
+};
+
+// Threads the calling thread may spread its work over, every core unless it holds a ThreadBudget
+inline unsigned hardwareThreads() {
+    if (const unsigned budget = ThreadBudget::limit())
+        return budget;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, count) into one contiguous block per thread and runs op(begin, end) on each,
+// the calling thread takes the first block. Returns once every block is done.
+template <class Op>
+void parallelBlocks(size_t count, Op op, unsigned threads = hardwareThreads()) {
+    const size_t blocks = std::max<size_t>(1ul, std::min<size_t>(threads, count));
+    const size_t stride = (count + blocks - 1ul) / blocks;
+
+    std::vector<std::jthread> workers;
+    workers.reserve(blocks - 1ul);
+    for (size_t block = 1ul; block < blocks; ++block) {
+        const size_t begin = std::min(count, block * stride), end = std::min(count, begin + stride);
+        workers.emplace_back([=, &op]{ op(begin, end); });
+    }
+
+    op(0ul, std::min(count, stride));
+}
+
+// Runs op(i) for every i in [0, count) across all threads
+template <class Op>
+void parallelFor(size_t count, Op op, unsigned threads = hardwareThreads()) {
+    parallelBlocks(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            op(i);
+    }, threads);
+}
@@ -0,0 +1,176 @@
+#include "progressive.h"
+
+#include "mappedfile.h"
+
+#include <algorithm> // adjacent_find, find, min, sort
+#include <cstring>   // memcmp, memcpy
+#include <string>    // string, to_string
+#include <vector>    // vector
+
+using namespace std;
+
+
+///////////////////////
+// ProgressiveReader //
+///////////////////////
+void ProgressiveReader::feed(const void* data, size_t bytes) {
+    const char *bytesIn = static_cast<const char*>(data);
+    m_pending.insert(m_pending.end(), bytesIn, bytesIn + bytes);
+
+    for (bool progressing = true; progressing;) {
+        switch (m_stage) {
+        case Stage::Header: progressing = readHeader(); break;
+        case Stage::Base:   progressing = readBase(); break;
+        case Stage::Splits: progressing = m_splitsApplied < min<size_t>(m_maxSplits, m_header.splitCount) && readSplit(); break;
+        }
+    }
+
+    // Keep only the partial record still waiting on more bytes
+    m_pending.erase(m_pending.begin(), m_pending.begin() + m_consumed);
+    m_consumed = 0ul;
+}
+
+bool ProgressiveReader::readHeader() {
+    if (m_pending.size() - m_consumed < sizeof(ProgressiveHeader))
+        return false;
+
+    memcpy(&m_header, m_pending.data() + m_consumed, sizeof(ProgressiveHeader));
+    if (memcmp(m_header.magic, ProgressiveHeader::expectedMagic, sizeof(m_header.magic)) != 0)
+        throw string("Not a progressive mesh stream");
+    if (m_header.version != ProgressiveHeader::currentVersion)
+        throw string("Unsupported progressive mesh version ") + to_string(m_header.version);
+
+    m_consumed += sizeof(ProgressiveHeader);
+    m_stage = Stage::Base;
+    return true;
+}
+
+bool ProgressiveReader::readBase() {
+    const size_t bytes = m_header.baseVertexCount * sizeof(f32v3)
+                       + (size_t(m_header.baseFaceCount) + m_header.baseCornerCount) * sizeof(uint32_t);
+    if (m_pending.size() - m_consumed < bytes)
+        return false;
+
+    const char *it = m_pending.data() + m_consumed;
+    m_positions.resize(m_header.baseVertexCount);
+    memcpy(m_positions.data(), it, m_positions.size() * sizeof(f32v3));
+    it += m_positions.size() * sizeof(f32v3);
+
+    vector<uint32_t> degrees(m_header.baseFaceCount);
+    memcpy(degrees.data(), it, degrees.size() * sizeof(uint32_t));
+    it += degrees.size() * sizeof(uint32_t);
+
+    // The degrees decide where every face's corners start, so they have to add up before any corner is read
+    size_t corners = 0ul;
+    for (uint32_t degree : degrees) {
+        if (degree < 3u)
+            throw string("Progressive mesh base has a face with ") + to_string(degree) + " corners";
+        corners += degree;
+    }
+    if (corners != m_header.baseCornerCount)
+        throw string("Progressive mesh base faces have ") + to_string(corners) + " corners, its header says "
+            + to_string(m_header.baseCornerCount);
+
+    m_faces.resize(m_header.baseFaceCount);
+    for (size_t face = 0ul; face < m_faces.size(); ++face) {
+        m_faces[face].resize(degrees[face]);
+        memcpy(m_faces[face].data(), it, degrees[face] * sizeof(uint32_t));
+        it += degrees[face] * sizeof(uint32_t);
+
+        for (uint32_t corner : m_faces[face])
+            if (corner >= m_positions.size())
+                throw string("Progressive mesh base face ") + to_string(face) + " uses missing vertex " + to_string(corner);
+    }
+
+    m_consumed += bytes;
+    m_stage = Stage::Splits;
+    return true;
+}
+
+bool ProgressiveReader::readSplit() {
+    ProgressiveSplit split;
+    if (m_pending.size() - m_consumed < sizeof(ProgressiveSplit))
+        return false;
+    memcpy(&split, m_pending.data() + m_consumed, sizeof(ProgressiveSplit));
+
+    const size_t bytes = sizeof(ProgressiveSplit) + split.editCount * sizeof(uint32_t);
+    if (m_pending.size() - m_consumed < bytes)
+        return false;
+
+    // Check the whole record before applying any of it, so a bad one leaves the mesh as it was
+    const uint32_t vertex = split.vertex, added = static_cast<uint32_t>(m_positions.size());
+    const string where = "Progressive mesh split " + to_string(m_splitsApplied);
+    if (vertex >= added)
+        throw where + " splits missing vertex " + to_string(vertex);
+    for (int side = 0; side < 2; ++side)
+        if (split.triangles & (1u << side) && (split.apexes[side] >= added || split.apexes[side] == vertex))
+            throw where + " has a triangle on missing vertex " + to_string(split.apexes[side]);
+
+    const char *edits = m_pending.data() + m_consumed + sizeof(ProgressiveSplit);
+    vector<uint32_t> edited(split.editCount);
+    for (uint16_t i = 0u; i < split.editCount; ++i) {
+        uint32_t edit;
+        memcpy(&edit, edits + i * sizeof(uint32_t), sizeof(uint32_t));
+
+        const uint32_t face = edited[i] = edit & ~ProgressiveSplit::EditMask;
+        if ((edit & ProgressiveSplit::EditMask) == ProgressiveSplit::EditMask)
+            throw where + " has an unknown edit";
+        if (face >= m_faces.size())
+            throw where + " edits missing face " + to_string(face);
+        if (find(m_faces[face].begin(), m_faces[face].end(), vertex) == m_faces[face].end())
+            throw where + " edits face " + to_string(face) + ", which does not hold vertex " + to_string(vertex);
+    }
+
+    // A face edited twice would no longer hold vertex the second time
+    sort(edited.begin(), edited.end());
+    if (adjacent_find(edited.begin(), edited.end()) != edited.end())
+        throw where + " edits a face more than once";
+
+    m_positions[vertex] = split.vertexPos;
+    m_positions.push_back(split.newPos);
+
+    if (split.triangles & 1u)
+        m_faces.push_back({ vertex, added, split.apexes[0] });
+    if (split.triangles & 2u)
+        m_faces.push_back({ added, vertex, split.apexes[1] });
+
+    for (uint16_t i = 0u; i < split.editCount; ++i) {
+        uint32_t edit;
+        memcpy(&edit, edits + i * sizeof(uint32_t), sizeof(uint32_t));
+
+        vector<uint32_t> &face = m_faces[edit & ~ProgressiveSplit::EditMask];
+        const auto corner = find(face.begin(), face.end(), vertex);
+        switch (edit & ProgressiveSplit::EditMask) {
+        case ProgressiveSplit::Replace:      *corner = added; break;
+        case ProgressiveSplit::InsertAfter:  face.insert(corner + 1, added); break;
+        case ProgressiveSplit::InsertBefore: face.insert(corner, added); break;
+        }
+    }
+
+    m_consumed += bytes;
+    ++m_splitsApplied;
+    return true;
+}
+
+MeshData ProgressiveReader::mesh() const {
+    MeshData mesh;
+    mesh.positions = m_positions;
+    mesh.faceStarts.reserve(m_faces.size() + 1ul);
+    for (const vector<uint32_t> &face : m_faces) {
+        mesh.indices.insert(mesh.indices.end(), face.begin(), face.end());
+        mesh.faceStarts.push_back(static_cast<uint32_t>(mesh.indices.size()));
+    }
+    return mesh;
+}
+
+
+MeshData readProgressive(const char* file, size_t splits) {
+    const MappedFile mapped(file);
+
+    ProgressiveReader reader(splits);
+    reader.feed(mapped.data(), mapped.size());
+    if (!reader.ready())
+        throw string("Progressive mesh ") + file + " is truncated";
+
+    return reader.mesh();
+}
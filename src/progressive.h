@@ -0,0 +1,78 @@
+#pragma once
+
+#include "meshio.h"
+#include "simd.h"
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint16_t, uint32_t
+#include <vector>  // vector
+
+
+// Progressive mesh stream: the header, then the coarse base mesh (positions, one degree per face, then every
+// face's corners), then vertex splits in refinement order. Each split is a fixed record followed by its face
+// edits, so a reader can draw the base as soon as it arrives and refine with every record after it.
+struct ProgressiveHeader {
+    static constexpr char expectedMagic[8] = { 'S', 'M', 'P', 'L', 'P', 'R', 'O', 'G' };
+    static constexpr uint32_t currentVersion = 1u;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t baseVertexCount, baseFaceCount, baseCornerCount;
+    uint32_t splitCount;
+};
+
+// Splits vertex in two. The new vertex takes the next vertex id, and each new triangle the next face id, the
+// one on the first side before the one on the second. A triangle on the first side winds vertex, new vertex,
+// apex, one on the second winds new vertex, vertex, apex.
+struct ProgressiveSplit {
+    // What an edit does to a face that held vertex before the split, kept in the top bits of the face id
+    enum Edit : uint32_t {
+        Replace = 0u << 30u,      // The new vertex takes its corner
+        InsertAfter = 1u << 30u,  // The new vertex joins it right after vertex, the first side's polygon
+        InsertBefore = 2u << 30u, // The new vertex joins it right before vertex, the second side's polygon
+        EditMask = 3u << 30u,
+    };
+
+    uint32_t vertex;
+    f32v3 vertexPos, newPos;
+    uint32_t apexes[2];
+    uint8_t triangles; // One bit per side that grows a new triangle
+    uint8_t padding;
+    uint16_t editCount;
+};
+
+// Rebuilds a progressive stream as its bytes arrive, every whole split is applied as soon as it is in
+class ProgressiveReader {
+public:
+    // Splits past maxSplits are ignored, leaving the mesh at that level
+    explicit ProgressiveReader(size_t maxSplits = ~size_t(0)) : m_maxSplits(maxSplits) {}
+
+    void feed(const void* data, size_t bytes);
+
+    // The base mesh has arrived, so there is something to show
+    bool ready() const { return m_stage == Stage::Splits; }
+    size_t splitsApplied() const { return m_splitsApplied; }
+    size_t splitCount() const { return m_header.splitCount; }
+
+    MeshData mesh() const;
+
+private:
+    enum class Stage { Header, Base, Splits };
+
+    // Consumes one stage's worth of pending bytes, returns false until enough of them are in
+    bool readHeader();
+    bool readBase();
+    bool readSplit();
+
+    Stage m_stage = Stage::Header;
+    ProgressiveHeader m_header = {};
+    std::vector<char> m_pending;
+    size_t m_consumed = 0ul;
+
+    std::vector<f32v3> m_positions;
+    std::vector<std::vector<uint32_t>> m_faces;
+    size_t m_splitsApplied = 0ul, m_maxSplits;
+};
+
+// Reads a whole progressive file, refined by at most splits records
+MeshData readProgressive(const char* file, size_t splits = ~size_t(0));
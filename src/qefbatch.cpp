@@ -0,0 +1,386 @@
+#include "qefbatch.h"
+
+#include <cstdint> // int32_t
+#include <cstring> // memcpy
+
+using namespace std;
+
+
+///////////
+// LANES //
+///////////
+// The kernels are written once over W lanes of GCC's vector extensions and compiled into each instruction set by the
+// entry points at the bottom, which carry the target. Everything in between is inlined into them, and takes its
+// vectors by reference, so no vector ever crosses a call built for a narrower target.
+namespace {
+    template <size_t W>
+    struct Lanes {
+        typedef float V __attribute__((vector_size(W * sizeof(float))));
+        typedef int32_t M __attribute__((vector_size(W * sizeof(float))));
+    };
+
+    template <size_t W>
+    [[gnu::always_inline]] inline void load(typename Lanes<W>::V& v, const float* from) {
+        memcpy(&v, from, sizeof v);
+    }
+
+    template <size_t W>
+    [[gnu::always_inline]] inline void store(float* to, const typename Lanes<W>::V& v) {
+        memcpy(to, &v, sizeof v);
+    }
+
+    template <size_t W>
+    [[gnu::always_inline]] inline bool any(const typename Lanes<W>::M& mask) {
+        for (size_t i = 0ul; i < W; ++i)
+            if (mask[i])
+                return true;
+        return false;
+    }
+
+    // 1/sqrt(x) for x of at least 1, by Newton's method from the old bit trick. Three steps is float rounding, and
+    // it is only arithmetic, so it vectorizes at any width where a call to sqrt would not.
+    template <size_t W>
+    [[gnu::always_inline]] inline void inverseSqrt(typename Lanes<W>::V& y, const typename Lanes<W>::V& x) {
+        using V = typename Lanes<W>::V;
+        using M = typename Lanes<W>::M;
+
+        y = (V)(0x5f3759df - ((M)x >> 1));
+        for (int step = 0; step < 3; ++step)
+            y = y * (1.5f - 0.5f * x * y * y);
+    }
+}
+
+
+/////////////////
+// DistanceQEF //
+/////////////////
+void QEFBatch<DistanceQEF>::push(const DistanceQEF& qef) {
+    n[count] = qef.n;
+    Svx[count] = qef.Sv.x;
+    Svy[count] = qef.Sv.y;
+    Svz[count] = qef.Sv.z;
+    Svtv[count] = qef.Svtv;
+    ++count;
+}
+
+DistanceQEF QEFBatch<DistanceQEF>::operator[](size_t i) const {
+    return { n[i], { Svx[i], Svy[i], Svz[i] }, Svtv[i] };
+}
+
+namespace {
+    // The same arithmetic in the same order as DistanceQEF
+    template <size_t W>
+    [[gnu::always_inline]] inline void evaluateLanes(const QEFBatch<DistanceQEF>& batch, size_t i, typename Lanes<W>::V& error) {
+        using V = typename Lanes<W>::V;
+        V x, y, z, n, Svx, Svy, Svz, Svtv;
+        load<W>(x, batch.x + i), load<W>(y, batch.y + i), load<W>(z, batch.z + i);
+        load<W>(n, batch.n + i), load<W>(Svx, batch.Svx + i), load<W>(Svy, batch.Svy + i), load<W>(Svz, batch.Svz + i);
+        load<W>(Svtv, batch.Svtv + i);
+
+        error = n * (x * x + y * y + z * z) - 2.0f * (x * Svx + y * Svy + z * Svz) + Svtv;
+    }
+
+    template <size_t W>
+    [[gnu::always_inline]] inline void minimizeLanes(QEFBatch<DistanceQEF>& batch) {
+        using V = typename Lanes<W>::V;
+        for (size_t i = 0ul; i < batch.count; i += W) {
+            V n, Svx, Svy, Svz;
+            load<W>(n, batch.n + i), load<W>(Svx, batch.Svx + i), load<W>(Svy, batch.Svy + i), load<W>(Svz, batch.Svz + i);
+            store<W>(batch.x + i, Svx / n), store<W>(batch.y + i, Svy / n), store<W>(batch.z + i, Svz / n);
+
+            V error;
+            evaluateLanes<W>(batch, i, error);
+            store<W>(batch.error + i, error);
+        }
+    }
+}
+
+
+//////////////
+// PlaneQEF //
+//////////////
+void QEFBatch<PlaneQEF>::push(const PlaneQEF& qef) {
+    a00[count] = qef.Snnt012.x;
+    a01[count] = qef.Snnt012.y;
+    a02[count] = qef.Snnt012.z;
+    a11[count] = qef.Snnt458.x;
+    a12[count] = qef.Snnt458.y;
+    a22[count] = qef.Snnt458.z;
+    bx[count] = qef.Snd.x;
+    by[count] = qef.Snd.y;
+    bz[count] = qef.Snd.z;
+    c[count] = qef.Sd2;
+    n[count] = qef.neighbors.n;
+    Svx[count] = qef.neighbors.Sv.x;
+    Svy[count] = qef.neighbors.Sv.y;
+    Svz[count] = qef.neighbors.Sv.z;
+    Svtv[count] = qef.neighbors.Svtv;
+    ++count;
+}
+
+PlaneQEF QEFBatch<PlaneQEF>::operator[](size_t i) const {
+    return { { a00[i], a01[i], a02[i] }, { a11[i], a12[i], a22[i] }, { bx[i], by[i], bz[i] }, c[i],
+             { n[i], { Svx[i], Svy[i], Svz[i] }, Svtv[i] } };
+}
+
+namespace {
+    template <size_t W>
+    [[gnu::always_inline]] inline void evaluateLanes(const QEFBatch<PlaneQEF>& batch, size_t i, typename Lanes<W>::V& error) {
+        using V = typename Lanes<W>::V;
+        V x, y, z, a00, a01, a02, a11, a12, a22, bx, by, bz, c, n, Svx, Svy, Svz, Svtv;
+        load<W>(x, batch.x + i), load<W>(y, batch.y + i), load<W>(z, batch.z + i);
+        load<W>(a00, batch.a00 + i), load<W>(a01, batch.a01 + i), load<W>(a02, batch.a02 + i);
+        load<W>(a11, batch.a11 + i), load<W>(a12, batch.a12 + i), load<W>(a22, batch.a22 + i);
+        load<W>(bx, batch.bx + i), load<W>(by, batch.by + i), load<W>(bz, batch.bz + i), load<W>(c, batch.c + i);
+        load<W>(n, batch.n + i), load<W>(Svx, batch.Svx + i), load<W>(Svy, batch.Svy + i), load<W>(Svz, batch.Svz + i);
+        load<W>(Svtv, batch.Svtv + i);
+
+        const V Ax = x * a00 + y * a01 + z * a02, Ay = x * a01 + y * a11 + z * a12, Az = x * a02 + y * a12 + z * a22;
+        const V neighbors = n * (x * x + y * y + z * z) - 2.0f * (x * Svx + y * Svy + z * Svz) + Svtv;
+        error = (x * Ax + y * Ay + z * Az) - 2.0f * (x * bx + y * by + z * bz) + c + PlaneQEF::tieWeight * neighbors;
+    }
+
+    // PlaneQEF::minimizeErrorImpl on every lane at once. The closed form is taken wherever it holds, and the Jacobi
+    // sweeps only run when some lane needs them, until every lane that does has converged.
+    template <size_t W>
+    [[gnu::always_inline]] inline void minimizeLanes(QEFBatch<PlaneQEF>& batch) {
+        using V = typename Lanes<W>::V;
+        using M = typename Lanes<W>::M;
+        const V zero = {}, one = zero + 1.0f, limit = zero + 1e15f;
+
+        for (size_t i = 0ul; i < batch.count; i += W) {
+            V a[3][3], b[3], n, Sv[3];
+            load<W>(a[0][0], batch.a00 + i), load<W>(a[0][1], batch.a01 + i), load<W>(a[0][2], batch.a02 + i);
+            load<W>(a[1][1], batch.a11 + i), load<W>(a[1][2], batch.a12 + i), load<W>(a[2][2], batch.a22 + i);
+            a[1][0] = a[0][1], a[2][0] = a[0][2], a[2][1] = a[1][2];
+            load<W>(b[0], batch.bx + i), load<W>(b[1], batch.by + i), load<W>(b[2], batch.bz + i);
+            load<W>(n, batch.n + i), load<W>(Sv[0], batch.Svx + i), load<W>(Sv[1], batch.Svy + i), load<W>(Sv[2], batch.Svz + i);
+
+            // Solve from the centroid, for the right hand side left over there
+            V centroid[3], r[3];
+            for (int k = 0; k < 3; ++k)
+                centroid[k] = Sv[k] / n;
+            for (int k = 0; k < 3; ++k)
+                r[k] = b[k] - (centroid[0] * a[k][0] + centroid[1] * a[k][1] + centroid[2] * a[k][2]);
+
+            const V c00 = a[1][1] * a[2][2] - a[1][2] * a[1][2], c01 = a[0][2] * a[1][2] - a[0][1] * a[2][2];
+            const V c02 = a[0][1] * a[1][2] - a[0][2] * a[1][1], c11 = a[0][0] * a[2][2] - a[0][2] * a[0][2];
+            const V c12 = a[0][1] * a[0][2] - a[0][0] * a[1][2], c22 = a[0][0] * a[1][1] - a[0][1] * a[0][1];
+            const V det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02, trace = a[0][0] + a[1][1] + a[2][2];
+            const M closed = det > PlaneQEF::rankTolerance * trace * trace * trace;
+
+            V x[3] = { (c00 * r[0] + c01 * r[1] + c02 * r[2]) / det,
+                       (c01 * r[0] + c11 * r[1] + c12 * r[2]) / det,
+                       (c02 * r[0] + c12 * r[1] + c22 * r[2]) / det };
+
+            if (any<W>(closed == 0)) {
+                V v[3][3] = { { one, zero, zero }, { zero, one, zero }, { zero, zero, one } };
+                constexpr int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+                // A lane gone NaN compares false, counting as converged rather than holding the rest back
+                for (int sweep = 0; sweep < 8; ++sweep) {
+                    const V off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+                    if (!any<W>(off > 1e-12f * trace * trace))
+                        break;
+
+                    for (const auto &[p, q] : pairs) {
+                        const int o = 3 - p - q;
+
+                        // Lanes with nothing to rotate get t = 0, the identity, instead of branching around them
+                        V theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+                        theta = theta > limit ? limit : theta < -limit ? -limit : theta;
+                        const V magnitude = (V)((M)theta & 0x7fffffff), square = theta * theta + 1.0f;
+
+                        V root, cosine;
+                        inverseSqrt<W>(root, square);
+                        V t = (theta < 0.0f ? -one : one) / (magnitude + square * root);
+                        t = a[p][q] != 0.0f ? t : zero;
+                        inverseSqrt<W>(cosine, t * t + 1.0f);
+                        const V sine = t * cosine;
+
+                        const V apq = a[p][q], aop = a[o][p], aoq = a[o][q];
+                        a[p][p] -= t * apq;
+                        a[q][q] += t * apq;
+                        a[p][q] = a[q][p] = zero;
+                        a[o][p] = a[p][o] = cosine * aop - sine * aoq;
+                        a[o][q] = a[q][o] = sine * aop + cosine * aoq;
+
+                        for (int k = 0; k < 3; ++k) {
+                            const V vkp = v[k][p], vkq = v[k][q];
+                            v[k][p] = cosine * vkp - sine * vkq;
+                            v[k][q] = sine * vkp + cosine * vkq;
+                        }
+                    }
+                }
+
+                // Eigenvectors are the columns of v, any direction too flat to trust is left out
+                V largest = a[0][0] > a[1][1] ? a[0][0] : a[1][1];
+                largest = largest > a[2][2] ? largest : a[2][2];
+
+                V pseudo[3] = { zero, zero, zero };
+                for (int e = 0; e < 3; ++e) {
+                    const V along = (v[0][e] * r[0] + v[1][e] * r[1] + v[2][e] * r[2]) / a[e][e];
+                    const M keep = a[e][e] > PlaneQEF::rankTolerance * largest;
+                    for (int k = 0; k < 3; ++k)
+                        pseudo[k] += keep ? v[k][e] * along : zero;
+                }
+                for (int k = 0; k < 3; ++k)
+                    x[k] = closed ? x[k] : pseudo[k];
+            }
+
+            store<W>(batch.x + i, centroid[0] + x[0]), store<W>(batch.y + i, centroid[1] + x[1]), store<W>(batch.z + i, centroid[2] + x[2]);
+
+            V error;
+            evaluateLanes<W>(batch, i, error);
+            store<W>(batch.error + i, error);
+        }
+    }
+}
+
+
+///////////////
+// FacePlane //
+///////////////
+void PlaneBatch::push(const f32v3& p0, const f32v3& p1, const f32v3& p2, const f32v3& p3) {
+    x0[count] = p0.x, y0[count] = p0.y, z0[count] = p0.z;
+    x1[count] = p1.x, y1[count] = p1.y, z1[count] = p1.z;
+    x2[count] = p2.x, y2[count] = p2.y, z2[count] = p2.z;
+    x3[count] = p3.x, y3[count] = p3.y, z3[count] = p3.z;
+    ++count;
+}
+
+namespace {
+    // The same cross product as Manifold::normal. Dividing by the largest component first puts the squared length in
+    // [1, 3], where inverseSqrt holds however small the face, and a degenerate face divides 0 by 0 to come out not a
+    // number just as FacePlane's does.
+    template <size_t W>
+    [[gnu::always_inline]] inline void planeLanes(PlaneBatch& batch) {
+        using V = typename Lanes<W>::V;
+        for (size_t i = 0ul; i < batch.count; i += W) {
+            V x0, y0, z0, x1, y1, z1, x2, y2, z2, x3, y3, z3;
+            load<W>(x0, batch.x0 + i), load<W>(y0, batch.y0 + i), load<W>(z0, batch.z0 + i);
+            load<W>(x1, batch.x1 + i), load<W>(y1, batch.y1 + i), load<W>(z1, batch.z1 + i);
+            load<W>(x2, batch.x2 + i), load<W>(y2, batch.y2 + i), load<W>(z2, batch.z2 + i);
+            load<W>(x3, batch.x3 + i), load<W>(y3, batch.y3 + i), load<W>(z3, batch.z3 + i);
+
+            const V ex = x2 - x0, ey = y2 - y0, ez = z2 - z0, fx = x3 - x1, fy = y3 - y1, fz = z3 - z1;
+            V nx = ey * fz - ez * fy, ny = ez * fx - ex * fz, nz = ex * fy - ey * fx;
+
+            const V ax = nx < 0.0f ? -nx : nx, ay = ny < 0.0f ? -ny : ny, az = nz < 0.0f ? -nz : nz;
+            const V largest = ax > ay ? (ax > az ? ax : az) : (ay > az ? ay : az);
+            nx /= largest, ny /= largest, nz /= largest;
+
+            V scale;
+            inverseSqrt<W>(scale, nx * nx + ny * ny + nz * nz);
+            nx *= scale, ny *= scale, nz *= scale;
+            store<W>(batch.nx + i, nx), store<W>(batch.ny + i, ny), store<W>(batch.nz + i, nz);
+            store<W>(batch.d + i, x0 * nx + y0 * ny + z0 * nz);
+        }
+    }
+}
+
+
+//////////////
+// DISPATCH //
+//////////////
+namespace {
+    template <size_t W, class QEF>
+    [[gnu::always_inline]] inline void evaluateAll(QEFBatch<QEF>& batch) {
+        for (size_t i = 0ul; i < batch.count; i += W) {
+            typename Lanes<W>::V error;
+            evaluateLanes<W>(batch, i, error);
+            store<W>(batch.error + i, error);
+        }
+    }
+
+    // Both fuse multiplies and adds, so errors can differ from the scalar ones in the last bit. Minimizers of the
+    // distance metric are a single divide and come out identical.
+#if defined(__x86_64__) || defined(__i386__)
+    template <class QEF> __attribute__((target("avx2,fma"))) void minimizeAVX2(QEFBatch<QEF>& batch) { minimizeLanes<8>(batch); }
+    template <class QEF> __attribute__((target("avx2,fma"))) void evaluateAVX2(QEFBatch<QEF>& batch) { evaluateAll<8>(batch); }
+    template <class QEF> __attribute__((target("avx512f"))) void minimizeAVX512(QEFBatch<QEF>& batch) { minimizeLanes<16>(batch); }
+    template <class QEF> __attribute__((target("avx512f"))) void evaluateAVX512(QEFBatch<QEF>& batch) { evaluateAll<16>(batch); }
+    __attribute__((target("avx2,fma"))) void planeAVX2(PlaneBatch& batch) { planeLanes<8>(batch); }
+    __attribute__((target("avx512f"))) void planeAVX512(PlaneBatch& batch) { planeLanes<16>(batch); }
+#endif
+}
+
+SimdLevel simdLevel() {
+#if defined(__x86_64__) || defined(__i386__)
+    // The AVX2 kernels are built with FMA as well, which a few CPUs have AVX2 without
+    static const SimdLevel level = __builtin_cpu_supports("avx512f")                                  ? SimdLevel::AVX512
+                                 : __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SimdLevel::AVX2
+                                                                                                   : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2:   return "avx2";
+    default:                return "scalar";
+    }
+}
+
+template <class QEF>
+void minimizeBatch(QEFBatch<QEF>& batch, SimdLevel level) {
+    // Never run wider than the CPU can, whatever was asked for
+    switch (min(level, simdLevel())) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SimdLevel::AVX512: minimizeAVX512(batch); return;
+    case SimdLevel::AVX2:   minimizeAVX2(batch); return;
+#endif
+    default: break;
+    }
+
+    for (size_t i = 0ul; i < batch.count; ++i) {
+        const QEF qef = batch[i];
+        const f32v3 p = qef.minimizeError();
+        batch.setPoint(i, p);
+        batch.error[i] = qef.evaluateError(p);
+    }
+}
+
+template <class QEF>
+void evaluateBatch(QEFBatch<QEF>& batch, SimdLevel level) {
+    switch (min(level, simdLevel())) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SimdLevel::AVX512: evaluateAVX512(batch); return;
+    case SimdLevel::AVX2:   evaluateAVX2(batch); return;
+#endif
+    default: break;
+    }
+
+    for (size_t i = 0ul; i < batch.count; ++i)
+        batch.error[i] = batch[i].evaluateError(batch.point(i));
+}
+
+void planeBatch(PlaneBatch& batch, SimdLevel level) {
+    switch (min(level, simdLevel())) {
+#if defined(__x86_64__) || defined(__i386__)
+    case SimdLevel::AVX512: planeAVX512(batch); return;
+    case SimdLevel::AVX2:   planeAVX2(batch); return;
+#endif
+    default: break;
+    }
+
+    for (size_t i = 0ul; i < batch.count; ++i) {
+        const f32v3 p0 = { batch.x0[i], batch.y0[i], batch.z0[i] }, p1 = { batch.x1[i], batch.y1[i], batch.z1[i] },
+                    p2 = { batch.x2[i], batch.y2[i], batch.z2[i] }, p3 = { batch.x3[i], batch.y3[i], batch.z3[i] };
+        const f32v3 n = (p2 - p0).cross(p3 - p1).normalize();
+        batch.nx[i] = n.x, batch.ny[i] = n.y, batch.nz[i] = n.z;
+        batch.d[i] = p0.dot(n);
+    }
+}
+
+
+//////////////////////////////////////
+// TEMPLATE DECLARATIONS FOR SANITY //
+//////////////////////////////////////
+template void minimizeBatch(QEFBatch<DistanceQEF>& batch, SimdLevel level);
+template void minimizeBatch(QEFBatch<PlaneQEF>& batch, SimdLevel level);
+template void evaluateBatch(QEFBatch<DistanceQEF>& batch, SimdLevel level);
+template void evaluateBatch(QEFBatch<PlaneQEF>& batch, SimdLevel level);
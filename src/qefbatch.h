@@ -0,0 +1,85 @@
+#pragma once
+
+#include "errorfunction.h"
+
+#include <cstddef> // size_t
+
+
+// Instruction sets the batched kernels come in. Scalar solves each QEF on its own and is the reference the others
+// are held to, they agree with it to rounding.
+enum class SimdLevel {
+    Scalar,
+    AVX2,   // 8 QEFs at a time
+    AVX512  // 16 QEFs at a time
+};
+
+// Widest level this CPU runs, checked once
+SimdLevel simdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// Where every batch keeps its results, one array per coordinate so a kernel stores a whole register of them at once
+struct BatchPoints {
+    static constexpr size_t capacity = 256ul; // A multiple of every kernel's width, so none has a ragged tail
+
+    size_t count = 0ul;
+    alignas(64) float x[capacity] = {}, y[capacity] = {}, z[capacity] = {}, error[capacity] = {};
+
+    bool full() const { return count == capacity; }
+    f32v3 point(size_t i) const { return { x[i], y[i], z[i] }; }
+    void setPoint(size_t i, const f32v3& p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+};
+
+// Up to capacity QEFs laid out struct-of-arrays, a coefficient per array, for the kernels to load a register's worth
+// of the same coefficient at once
+template <class QEF>
+struct QEFBatch;
+
+template <>
+struct QEFBatch<DistanceQEF> : BatchPoints {
+    alignas(64) float n[capacity] = {}, Svx[capacity] = {}, Svy[capacity] = {}, Svz[capacity] = {}, Svtv[capacity] = {};
+
+    void push(const DistanceQEF& qef);
+    DistanceQEF operator[](size_t i) const;
+};
+
+template <>
+struct QEFBatch<PlaneQEF> : BatchPoints {
+    alignas(64) float a00[capacity] = {}, a01[capacity] = {}, a02[capacity] = {}, a11[capacity] = {}, a12[capacity] = {},
+                      a22[capacity] = {}, bx[capacity] = {}, by[capacity] = {}, bz[capacity] = {}, c[capacity] = {};
+    alignas(64) float n[capacity] = {}, Svx[capacity] = {}, Svy[capacity] = {}, Svz[capacity] = {}, Svtv[capacity] = {};
+
+    void push(const PlaneQEF& qef);
+    PlaneQEF operator[](size_t i) const;
+};
+
+// Up to capacity faces with their corners laid out struct-of-arrays, for the plane kernel to take a register's worth at
+// once. Corners are the four Manifold::normal crosses the diagonals of, so a triangle repeats its first as its fourth.
+struct PlaneBatch {
+    static constexpr size_t capacity = BatchPoints::capacity;
+
+    size_t count = 0ul;
+    alignas(64) float x0[capacity] = {}, y0[capacity] = {}, z0[capacity] = {}, x1[capacity] = {}, y1[capacity] = {},
+                      z1[capacity] = {}, x2[capacity] = {}, y2[capacity] = {}, z2[capacity] = {}, x3[capacity] = {},
+                      y3[capacity] = {}, z3[capacity] = {};
+    alignas(64) float nx[capacity] = {}, ny[capacity] = {}, nz[capacity] = {}, d[capacity] = {};
+
+    bool full() const { return count == capacity; }
+    void push(const f32v3& p0, const f32v3& p1, const f32v3& p2, const f32v3& p3);
+    FacePlane operator[](size_t i) const { return { { nx[i], ny[i], nz[i] }, d[i] }; }
+};
+
+// Whether QEF has a batch and kernels at all, any other is solved an edge at a time
+template <class QEF> inline constexpr bool batched = false;
+template <> inline constexpr bool batched<DistanceQEF> = true;
+template <> inline constexpr bool batched<PlaneQEF> = true;
+
+// Minimizes every QEF in the batch, leaving each minimizer and the error there in its results
+template <class QEF>
+void minimizeBatch(QEFBatch<QEF>& batch, SimdLevel level = simdLevel());
+
+// Errors of every QEF in the batch at the points already in its results
+template <class QEF>
+void evaluateBatch(QEFBatch<QEF>& batch, SimdLevel level = simdLevel());
+
+// The plane of every face in the batch, as FacePlane would work each out
+void planeBatch(PlaneBatch& batch, SimdLevel level = simdLevel());
@@ -18,7 +18,6 @@ struct v3 {
     inline v3& operator-=(const v3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
     inline v3& operator*=(T d)         { x *= d;   y *= d;   z *= d;   return *this; }
     inline v3& operator/=(T d)         { x /= d;   y /= d;   z /= d;   return *this; }
-    inline v3&  operator=(const v3& v) { x = v.x;  y = v.y;  z = v.z;  return *this; }
 
     inline T    dot(const v3& v) const { return x*v.x + y*v.y + z*v.z;                           }
     inline v3 cross(const v3& v) const { return { y*v.z - z*v.y, z*v.x - x*v.z, x*v.y - y*v.x }; }
@@ -30,6 +29,29 @@ struct v3 {
     inline T max() const { return std::max({ x, y, z });  }
 };
 
+template <typename T>
+struct v2 {
+    T x,y;
+
+    inline v2   operator+(const v2& v) const { return { x + v.x, y + v.y }; }
+    inline v2   operator-(const v2& v) const { return { x - v.x, y - v.y }; }
+    inline v2   operator*(T d)         const { return { x * d,   y * d };   }
+    inline v2   operator/(T d)         const { return { x / d,   y / d };   }
+    inline v2& operator+=(const v2& v) { x += v.x; y += v.y; return *this; }
+
+    inline T dot(const v2& v) const { return x*v.x + y*v.y; }
+};
+
+template <typename T>
+std::istream& operator>>(std::istream& is, v2<T>& v) {
+    return is >> v.x >> v.y;
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const v2<T>& v) {
+    return os << v.x << " " << v.y;
+}
+
 template <typename T>
 std::istream& operator>>(std::istream& is, v3<T>& v) {
     return is >> v.x >> v.y >> v.z;
@@ -41,4 +63,5 @@ std::ostream& operator<<(std::ostream& os, const v3<T>& v) {
 }
 
 
+using f32v2 = v2<float>;
 using f32v3 = v3<float>;
@@ -0,0 +1,114 @@
+#include "threadpool.h"
+
+#include "parallel.h"
+
+#include <algorithm> // max
+#include <utility>   // move
+
+using namespace std;
+
+
+// The pool and deque of the worker on this thread, if it is one
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local unsigned currentIndex = 0u;
+
+
+ThreadPool::ThreadPool(unsigned threads)
+  : m_queues(max(1u, threads)) {
+    // Read before any worker exists, so the share comes from this thread's own budget
+    const unsigned share = max(1u, hardwareThreads() / size());
+
+    m_workers.reserve(size());
+    for (unsigned index = 0u; index < size(); ++index)
+        m_workers.emplace_back([this, index, share] { work(index, share); });
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard lock(m_mutex);
+        ++m_pending;
+    }
+
+    {
+        Queue &queue = currentPool == this ? m_queues[currentIndex] : m_shared;
+        lock_guard lock(queue.mutex);
+        queue.tasks.push_back(move(task));
+    }
+
+    {
+        lock_guard lock(m_mutex);
+        ++m_queued;
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_pending == 0ul; });
+}
+
+void ThreadPool::work(unsigned index, unsigned share) {
+    currentPool = this;
+    currentIndex = index;
+    const ThreadBudget budget(share);
+
+    while (true) {
+        if (runOne(index))
+            continue;
+
+        // Nothing anywhere. Every push is counted and notified after it lands, so sleeping until the count is up misses none.
+        unique_lock lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stopping || m_queued > 0; });
+        if (m_stopping && m_queued <= 0)
+            return;
+    }
+}
+
+bool ThreadPool::runOne(unsigned index) {
+    function<void()> task;
+
+    // Newest of its own first, it is the likeliest still in cache. Then the oldest from outside, so those start in the
+    // order they came in, and last the oldest of each other worker in turn.
+    for (unsigned offset = 0u; offset <= size() && !task; ++offset) {
+        const bool own = offset == 0u;
+        Queue &queue = own ? m_queues[index] : offset == 1u ? m_shared : m_queues[(index + offset - 1u) % size()];
+        lock_guard lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        if (own) {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task)
+        return false;
+
+    {
+        lock_guard lock(m_mutex);
+        --m_queued;
+    }
+    task();
+
+    bool idle;
+    {
+        lock_guard lock(m_mutex);
+        idle = --m_pending == 0ul;
+    }
+    if (idle)
+        m_idle.notify_all();
+    return true;
+}
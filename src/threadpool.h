@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable> // condition_variable
+#include <cstddef>            // ptrdiff_t, size_t
+#include <deque>              // deque
+#include <functional>         // function
+#include <mutex>              // mutex
+#include <thread>             // jthread
+#include <vector>             // vector
+
+
+// A fixed set of worker threads, each with a deque of its own, and one shared queue for tasks submitted from outside.
+// A worker runs the tasks it submitted itself newest first, then outside tasks oldest first, then steals the oldest
+// task of another worker, so a few long tasks never leave the rest of the workers idle behind them. Outside tasks
+// start in the order they were submitted. Tasks see their even share of the cores through hardwareThreads(), and
+// must not throw.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool(); // Finishes every task first
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // From a worker the task goes on that worker's own deque, from anywhere else on the shared queue
+    void submit(std::function<void()> task);
+
+    // Blocks until every task submitted so far, and every one they submitted, is done. Never call it from a task.
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(m_queues.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void work(unsigned index, unsigned share);
+    bool runOne(unsigned index);
+
+    std::vector<Queue> m_queues;
+    Queue m_shared;
+
+    // Tasks on the deques and tasks not yet finished. Queued can dip below zero for a moment, when a task is taken
+    // between being pushed and being counted.
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_idle;
+    std::ptrdiff_t m_queued = 0;
+    size_t m_pending = 0ul;
+    bool m_stopping = false;
+
+    std::vector<std::jthread> m_workers;
+};